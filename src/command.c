@@ -85,7 +85,7 @@ const command_s cmd_list[] = {
 	{"jtag_scan", cmd_jtag_scan, "Scan JTAG chain for devices"},
 	{"swdp_scan", cmd_swdp_scan, "Scan SW-DP for devices"},
 	{"auto_scan", cmd_auto_scan, "Automatically scan all chain types for devices"},
-	{"frequency", cmd_frequency, "set minimum high and low times"},
+	{"frequency", cmd_frequency, "set minimum high and low times: (freq|auto)"},
 	{"targets", cmd_targets, "Display list of available targets"},
 	{"morse", cmd_morse, "Display morse error message"},
 	{"halt_timeout", cmd_halt_timeout, "Timeout (ms) to wait until Cortex-M is halted: (Default 2000)"},
@@ -343,8 +343,16 @@ bool cmd_auto_scan(target_s *t, int argc, const char **argv)
 
 bool cmd_frequency(target_s *t, int argc, const char **argv)
 {
-	(void)t;
-	if (argc == 2) {
+	if (argc == 2 && !strcmp(argv[1], "auto")) {
+		if (!t) {
+			gdb_out("Attach to a target to tune the frequency for\n");
+			return false;
+		}
+		if (!target_swj_frequency_tune(t)) {
+			gdb_out("Frequency tuning failed or is not supported for this probe and target\n");
+			return false;
+		}
+	} else if (argc == 2) {
 		char *multiplier = NULL;
 		uint32_t frequency = strtoul(argv[1], &multiplier, 10);
 		if (!multiplier) {
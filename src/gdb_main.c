@@ -55,6 +55,9 @@ typedef enum gdb_signal {
 
 #define BUF_SIZE 1024U
 
+/* Longest stretch, in ms, we let the target wait for a halt before looking at GDB and RTT again */
+#define HALT_WAIT_MAX 8U
+
 #define ERROR_IF_NO_TARGET()   \
 	if (!cur_target) {         \
 		gdb_putpacketz("EFF"); \
@@ -76,6 +79,7 @@ static void handle_q_packet(char *packet, size_t len);
 static void handle_v_packet(char *packet, size_t len);
 static void handle_z_packet(char *packet, size_t len);
 static void handle_kill_target(void);
+static void handle_halt_wait(void);
 
 static void gdb_target_destroy_callback(target_controller_s *tc, target_s *t)
 {
@@ -115,6 +119,27 @@ static target_controller_s gdb_controller = {
 	.system = hostio_system,
 };
 
+/*
+ * Whether a packet is answered without touching the target: handshakes and queries about the probe or
+ * what it already knows. vFlash packets carry on the flash operation any erase still running belongs to,
+ * which waits for it itself only where it has to, so they don't count as touching the target here either.
+ */
+static bool gdb_packet_is_target_free(const char *const packet)
+{
+	switch (packet[0]) {
+	case '\0':
+	case '!':
+	case 'H':
+		return true;
+	case 'q':
+		return strncmp(packet, "qRcmd,", 6U) != 0 && strncmp(packet, "qCRC:", 5U) != 0;
+	case 'v':
+		return !strncmp(packet, "vFlash", 6U) || !strcmp(packet, "vCont?") || !strcmp(packet, "vMustReplyEmpty");
+	default:
+		return false;
+	}
+}
+
 int gdb_main_loop(target_controller_s *tc, bool in_syscall)
 {
 	bool single_step = false;
@@ -127,6 +152,9 @@ int gdb_main_loop(target_controller_s *tc, bool in_syscall)
 		if (pbuf[0] != '\x04' || cur_target) {
 			SET_IDLE_STATE(0);
 		}
+		/* Nothing may touch the target while a flash erase left running from a previous packet is under way */
+		if (cur_target && !gdb_packet_is_target_free(pbuf))
+			target_flash_erase_wait(cur_target);
 		switch (pbuf[0]) {
 		/* Implementation of these is mandatory! */
 		case 'g': { /* 'g': Read general registers */
@@ -205,59 +233,13 @@ int gdb_main_loop(target_controller_s *tc, bool in_syscall)
 			SET_RUN_STATE(true);
 			single_step = false;
 			/* fall through */
-		case '?': { /* '?': Request reason for target halt */
+		case '?': /* '?': Request reason for target halt */
 			/*
 			 * This packet isn't documented as being mandatory,
 			 * but GDB doesn't work without it.
 			 */
-
-			if (!cur_target) {
-				/* Report "target exited" if no target */
-				gdb_putpacketz("W00");
-				break;
-			}
-
-			/* Wait for target halt */
-			target_addr_t watch;
-			target_halt_reason_e reason;
-			while (true) {
-				reason = target_halt_poll(cur_target, &watch);
-				if (reason != TARGET_HALT_RUNNING)
-					break;
-
-				const char gdb_ch = (char)gdb_if_getchar_to(0);
-				if (gdb_ch == '\x03' || gdb_ch == '\x04')
-					target_halt_request(cur_target);
-
-				platform_pace_poll();
-
-#ifdef ENABLE_RTT
-				if (rtt_enabled)
-					poll_rtt(cur_target);
-#endif
-			}
-			SET_RUN_STATE(false);
-
-			/* Translate reason to GDB signal */
-			switch (reason) {
-			case TARGET_HALT_ERROR:
-				gdb_putpacket_f("X%02X", GDB_SIGLOST);
-				morse("TARGET LOST.", true);
-				break;
-			case TARGET_HALT_REQUEST:
-				gdb_putpacket_f("T%02X", GDB_SIGINT);
-				break;
-			case TARGET_HALT_WATCHPOINT:
-				gdb_putpacket_f("T%02Xwatch:%08X;", GDB_SIGTRAP, watch);
-				break;
-			case TARGET_HALT_FAULT:
-				gdb_putpacket_f("T%02X", GDB_SIGSEGV);
-				break;
-			default:
-				gdb_putpacket_f("T%02X", GDB_SIGTRAP);
-			}
+			handle_halt_wait();
 			break;
-		}
 
 		/* Optional GDB packet support */
 		case 'p': { /* Read single register */
@@ -375,6 +357,70 @@ int gdb_main_loop(target_controller_s *tc, bool in_syscall)
 	}
 }
 
+/* Wait for the target to halt and send GDB the stop reply for it */
+static void handle_halt_wait(void)
+{
+	if (!cur_target) {
+		/* Report "target exited" if no target */
+		gdb_putpacketz("W00");
+		return;
+	}
+
+	/* Wait for target halt */
+	target_addr_t watch;
+	target_halt_reason_e reason;
+	uint32_t wait_slice = 0;
+	while (true) {
+		reason = target_halt_poll(cur_target, &watch);
+		if (reason != TARGET_HALT_RUNNING)
+			break;
+
+		const char gdb_ch = (char)gdb_if_getchar_to(0);
+		if (gdb_ch == '\x03' || gdb_ch == '\x04') {
+			target_halt_request(cur_target);
+			wait_slice = 0;
+			continue;
+		}
+
+#ifdef ENABLE_RTT
+		if (rtt_enabled)
+			poll_rtt(cur_target);
+#endif
+
+		/*
+		 * Only once the target is seen running free, rather than just resumed, halt requested or
+		 * stepping through a range (where each poll steps another instruction), is it left alone.
+		 * Have the target wait for the halt on the probe side then, which notices it as soon as it
+		 * happens, in slices that back off exponentially so long runs cost next to nothing.
+		 * Targets that can't do that get their polling paced instead.
+		 */
+		const bool idle = wait_slice && !target_halt_range_stepping(cur_target);
+		if (idle && !target_halt_wait(cur_target, wait_slice))
+			platform_pace_poll();
+		wait_slice = MIN(wait_slice ? wait_slice * 2U : 1U, HALT_WAIT_MAX);
+	}
+	SET_RUN_STATE(false);
+
+	/* Translate reason to GDB signal */
+	switch (reason) {
+	case TARGET_HALT_ERROR:
+		gdb_putpacket_f("X%02X", GDB_SIGLOST);
+		morse("TARGET LOST.", true);
+		break;
+	case TARGET_HALT_REQUEST:
+		gdb_putpacket_f("T%02X", GDB_SIGINT);
+		break;
+	case TARGET_HALT_WATCHPOINT:
+		gdb_putpacket_f("T%02Xwatch:%08X;", GDB_SIGTRAP, watch);
+		break;
+	case TARGET_HALT_FAULT:
+		gdb_putpacket_f("T%02X", GDB_SIGSEGV);
+		break;
+	default:
+		gdb_putpacket_f("T%02X", GDB_SIGTRAP);
+	}
+}
+
 static bool exec_command(char *packet, const size_t length, const cmd_executer_s *exec)
 {
 	while (exec->cmd_prefix) {
@@ -576,6 +622,34 @@ static void handle_v_packet(char *packet, const size_t plen)
 		} else
 			gdb_putpacketz("E01");
 
+	} else if (!strcmp(packet, "vCont?")) {
+		/* Signals given with C and S are accepted but ignored, as for c and s */
+		gdb_putpacketz("vCont;c;C;s;S;r");
+
+	} else if (!strncmp(packet, "vCont;", 6)) {
+		if (!cur_target) {
+			gdb_putpacketz("X1D");
+			return;
+		}
+		/* We only have the one thread, so only the first action can apply to it */
+		const char action = packet[6];
+		uint32_t range_start = 0;
+		uint32_t range_end = 0;
+		if (action == 'c' || action == 'C')
+			target_halt_resume(cur_target, false);
+		else if (action == 's' || action == 'S')
+			target_halt_resume(cur_target, true);
+		else if (action == 'r' && sscanf(packet + 7, "%" SCNx32 ",%" SCNx32, &range_start, &range_end) == 2)
+			/* 'r start,end': Step until the PC leaves [start, end), only reporting that final stop */
+			target_halt_resume_range(cur_target, range_start, range_end);
+		else {
+			DEBUG_GDB("*** Unsupported vCont action: %s\n", packet);
+			gdb_putpacketz("E01");
+			return;
+		}
+		SET_RUN_STATE(true);
+		handle_halt_wait();
+
 	} else if (!strncmp(packet, "vKill;", 6)) {
 		/* Kill the target - we don't actually care about the PID that follows "vKill;" */
 		handle_kill_target();
@@ -643,7 +717,8 @@ static void handle_v_packet(char *packet, const size_t plen)
 			return;
 		}
 
-		if (target_flash_erase(cur_target, addr, len))
+		/* GDB always follows up with vFlashDone, so blocks can be left to erase as they're written */
+		if (target_flash_erase_lazy(cur_target, addr, len))
 			gdb_putpacketz("OK");
 		else {
 			target_flash_complete(cur_target);
@@ -73,6 +73,17 @@ extern jtag_proc_s jtag_proc;
 /* Goto Run-test/Idle: 1, 1, 0 */
 #define jtagtap_return_idle(cycles) jtag_proc.jtagtap_tms_seq(0x01, (cycles) + 1U)
 
+/*
+ * Goto Update-DR/IR from Exit1: 1
+ * Shift-DR, Shift-IR and reset are reached from Update-DR/IR by the same TMS sequences as from
+ * Run-Test/Idle, so an IR scan can stop here and have the DR scan after it skip the idle state.
+ * DR scans only stop here when tap_idle_cycles is 0, as otherwise they owe the chain idle cycles.
+ */
+#define jtagtap_update() jtag_proc.jtagtap_tms_seq(0x01, 1U)
+
+/* Goto Run-test/Idle from Update-DR/IR and stay there: 0, ... */
+#define jtagtap_idle(cycles) jtag_proc.jtagtap_tms_seq(0x00U, cycles)
+
 #if PC_HOSTED == 1
 int platform_jtagtap_init(void);
 #else
@@ -59,10 +59,13 @@ bool target_mem_map(target_s *t, char *buf, size_t len);
 int target_mem_read(target_s *t, void *dest, target_addr_t src, size_t len);
 int target_mem_write(target_s *t, target_addr_t dest, const void *src, size_t len);
 bool target_mem_access_needs_halt(target_s *t);
+uint32_t target_swj_frequency_tune(target_s *t);
 /* Flash memory access functions */
 bool target_flash_erase(target_s *t, target_addr_t addr, size_t len);
+bool target_flash_erase_lazy(target_s *t, target_addr_t addr, size_t len);
 bool target_flash_write(target_s *t, target_addr_t dest, const void *src, size_t len);
 bool target_flash_complete(target_s *t);
+void target_flash_erase_wait(target_s *t);
 
 /* Register access functions */
 size_t target_regs_size(target_s *t);
@@ -86,7 +89,10 @@ typedef enum target_halt_reason {
 void target_reset(target_s *t);
 void target_halt_request(target_s *t);
 target_halt_reason_e target_halt_poll(target_s *t, target_addr_t *watch);
+bool target_halt_wait(target_s *t, uint32_t timeout);
 void target_halt_resume(target_s *t, bool step);
+void target_halt_resume_range(target_s *t, target_addr_t range_start, target_addr_t range_end);
+bool target_halt_range_stepping(target_s *t);
 void target_set_cmdline(target_s *t, char *cmdline);
 void target_set_heapinfo(target_s *t, target_addr_t heap_base, target_addr_t heap_limit, target_addr_t stack_base,
 	target_addr_t stack_limit);
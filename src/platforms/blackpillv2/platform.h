@@ -46,21 +46,33 @@
  *   * +3V3
  *     * PB8 - turn on IRLML5103 transistor
  *   * Force DFU mode button: PA0
+ *
+ * Built with SWD_SPI=1, TMS/SWDIO and TCK/SWCLK move to SPI2 so SWD can be clocked by the peripheral:
+ *   * PB13: TCK/SWCLK (SPI2 SCK)
+ *   * PB15: TMS/SWDIO (SPI2 MOSI)
+ *   * PB14: SPI2 MISO, must be wired to PB15
  */
 
 /* Hardware definitions... */
 #define JTAG_PORT GPIOA
 #define TDI_PORT  JTAG_PORT
-#define TMS_PORT  JTAG_PORT
-#define TCK_PORT  JTAG_PORT
 #define TDO_PORT  GPIOB
 #define TDI_PIN   GPIO1
-#define TMS_PIN   GPIO13
-#define TCK_PIN   GPIO14
 #define TDO_PIN   GPIO3
+#ifdef PLATFORM_SWD_SPI
+#define TMS_PORT GPIOB
+#define TCK_PORT GPIOB
+#define TMS_PIN  GPIO15
+#define TCK_PIN  GPIO13
+#else
+#define TMS_PORT JTAG_PORT
+#define TCK_PORT JTAG_PORT
+#define TMS_PIN  GPIO13
+#define TCK_PIN  GPIO14
+#endif
 
-#define SWDIO_PORT JTAG_PORT
-#define SWCLK_PORT JTAG_PORT
+#define SWDIO_PORT TMS_PORT
+#define SWCLK_PORT TCK_PORT
 #define SWDIO_PIN  TMS_PIN
 #define SWCLK_PIN  TCK_PIN
 
@@ -106,6 +118,30 @@
 #define SWDIO_MODE_FLOAT() gpio_mode_setup(SWDIO_PORT, GPIO_MODE_INPUT, GPIO_PUPD_NONE, SWDIO_PIN);
 
 #define SWDIO_MODE_DRIVE() gpio_mode_setup(SWDIO_PORT, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, SWDIO_PIN);
+
+#ifdef PLATFORM_SWD_SPI
+/* SPI2 runs from APB1 at 42MHz, so this clocks SWD at 10.5MHz. DMA1 stream 3/4 channel 0 serve SPI2 RX/TX */
+#define SWD_SPI                SPI2
+#define SWD_SPI_RCC            RCC_SPI2
+#define SWD_SPI_BAUDRATE       SPI_CR1_BAUDRATE_FPCLK_DIV_4
+#define SWD_SPI_DMA            DMA1
+#define SWD_SPI_DMA_RCC        RCC_DMA1
+#define SWD_SPI_DMA_RX_STREAM  DMA_STREAM3
+#define SWD_SPI_DMA_TX_STREAM  DMA_STREAM4
+#define SWD_SPI_DMA_CHANNEL    DMA_SxCR_CHSEL_0
+#define SWD_SPI_MISO_PORT      GPIOB
+#define SWD_SPI_MISO_PIN       GPIO14
+#define SWCLK_MODE_SPI()       gpio_mode_setup(SWCLK_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE, SWCLK_PIN);
+#define SWCLK_MODE_GPIO()      gpio_mode_setup(SWCLK_PORT, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, SWCLK_PIN);
+#define SWDIO_MODE_SPI()       gpio_mode_setup(SWDIO_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE, SWDIO_PIN);
+#define SWD_SPI_PIN_SETUP()                                                                                  \
+	do {                                                                                                     \
+		gpio_set_af(SWCLK_PORT, GPIO_AF5, SWCLK_PIN | SWDIO_PIN);                                            \
+		gpio_set_af(SWD_SPI_MISO_PORT, GPIO_AF5, SWD_SPI_MISO_PIN);                                          \
+		gpio_set_output_options(SWCLK_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, SWCLK_PIN | SWDIO_PIN);        \
+		gpio_mode_setup(SWD_SPI_MISO_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE, SWD_SPI_MISO_PIN);                  \
+	} while (0)
+#endif
 #define UART_PIN_SETUP()                                                                            \
 	do {                                                                                            \
 		gpio_mode_setup(USBUSART_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE, USBUSART_TX_PIN);              \
@@ -25,6 +25,12 @@
 #include "adiv5.h"
 #include "gdb_packet.h"
 
+#ifdef SWD_SPI
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma.h>
+#endif
+
 typedef enum swdio_status_e {
 	SWDIO_STATUS_FLOAT = 0,
 	SWDIO_STATUS_DRIVE
@@ -36,6 +42,11 @@ static bool swdptap_seq_in_parity(uint32_t *ret, size_t clock_cycles) __attribut
 static void swdptap_seq_out(uint32_t tms_states, size_t clock_cycles) __attribute__((optimize(3)));
 static void swdptap_seq_out_parity(uint32_t tms_states, size_t clock_cycles) __attribute__((optimize(3)));
 
+#ifdef SWD_SPI
+static uint32_t swdptap_seq_in_spi(size_t clock_cycles);
+static void swdptap_seq_out_spi(uint32_t tms_states, size_t clock_cycles);
+#endif
+
 static void swdptap_turnaround(const swdio_status_t dir)
 {
 	static swdio_status_t olddir = SWDIO_STATUS_FLOAT;
@@ -101,6 +112,10 @@ static uint32_t swdptap_seq_in_no_delay(const size_t clock_cycles)
 static uint32_t swdptap_seq_in(size_t clock_cycles)
 {
 	swdptap_turnaround(SWDIO_STATUS_FLOAT);
+#ifdef SWD_SPI
+	if (!swd_delay_cnt && clock_cycles >= 8U)
+		return swdptap_seq_in_spi(clock_cycles);
+#endif
 	if (swd_delay_cnt)
 		return swdptap_seq_in_swd_delay(clock_cycles);
 	else // NOLINT(readability-else-after-return)
@@ -154,9 +169,109 @@ static void swdptap_seq_out_no_delay(const uint32_t tms_states, const size_t clo
 	gpio_clear(SWCLK_PORT, SWCLK_PIN);
 }
 
+#ifdef SWD_SPI
+/*
+ * SPI driven SWD engine, for platforms that put SWCLK on the SCK pin of an SPI peripheral and SWDIO on its
+ * MOSI pin, with the MISO pin wired to SWDIO as well. At full speed the whole bytes of a sequence are
+ * shifted by the peripheral, LSB first in mode 0, with DMA feeding and draining the data register. That
+ * matches the target sampling SWDIO on the rising edge of SWCLK and us sampling the target's data just
+ * before it. Turnarounds, ACKs, parity bits and any bits left over after the whole bytes stay with the
+ * GPIO engine, so the pins are handed back to it after every burst.
+ *
+ * The platform defines SWD_SPI (the peripheral), SWD_SPI_RCC and SWD_SPI_BAUDRATE, the DMA controller,
+ * streams and channel serving the peripheral, SWD_SPI_MISO_PORT/PIN, SWD_SPI_PIN_SETUP() to route the pins'
+ * alternate functions, and SWCLK_MODE_SPI(), SWCLK_MODE_GPIO() and SWDIO_MODE_SPI() to switch them over.
+ */
+
+/* Sequences are at most 32 bits, so 4 bytes each way */
+static uint8_t swdptap_spi_tx[4];
+static uint8_t swdptap_spi_rx[4];
+
+static void swdptap_spi_dma_setup(const uint8_t stream, const uint32_t direction, uint8_t *const buffer,
+	const size_t bytes)
+{
+	dma_stream_reset(SWD_SPI_DMA, stream);
+	dma_channel_select(SWD_SPI_DMA, stream, SWD_SPI_DMA_CHANNEL);
+	dma_set_transfer_mode(SWD_SPI_DMA, stream, direction);
+	dma_set_peripheral_address(SWD_SPI_DMA, stream, (uint32_t)&SPI_DR(SWD_SPI));
+	dma_set_memory_address(SWD_SPI_DMA, stream, (uint32_t)buffer);
+	dma_set_number_of_data(SWD_SPI_DMA, stream, bytes);
+	dma_enable_memory_increment_mode(SWD_SPI_DMA, stream);
+	dma_set_peripheral_size(SWD_SPI_DMA, stream, DMA_SxCR_PSIZE_8BIT);
+	dma_set_memory_size(SWD_SPI_DMA, stream, DMA_SxCR_MSIZE_8BIT);
+	dma_enable_stream(SWD_SPI_DMA, stream);
+}
+
+/* Clock bytes out of swdptap_spi_tx and into swdptap_spi_rx, returning once the last has been received */
+static void swdptap_spi_transfer(const size_t bytes)
+{
+	SWCLK_MODE_SPI();
+	/* The receive side has to be ready before the first byte goes out */
+	swdptap_spi_dma_setup(SWD_SPI_DMA_RX_STREAM, DMA_SxCR_DIR_PERIPHERAL_TO_MEM, swdptap_spi_rx, bytes);
+	swdptap_spi_dma_setup(SWD_SPI_DMA_TX_STREAM, DMA_SxCR_DIR_MEM_TO_PERIPHERAL, swdptap_spi_tx, bytes);
+	spi_enable_rx_dma(SWD_SPI);
+	spi_enable_tx_dma(SWD_SPI);
+	spi_enable(SWD_SPI);
+	/* The last byte being received means the last clock has gone out too */
+	while (!dma_get_interrupt_flag(SWD_SPI_DMA, SWD_SPI_DMA_RX_STREAM, DMA_TCIF))
+		continue;
+	spi_disable_tx_dma(SWD_SPI);
+	spi_disable_rx_dma(SWD_SPI);
+	spi_disable(SWD_SPI);
+	dma_disable_stream(SWD_SPI_DMA, SWD_SPI_DMA_TX_STREAM);
+	dma_disable_stream(SWD_SPI_DMA, SWD_SPI_DMA_RX_STREAM);
+	gpio_clear(SWCLK_PORT, SWCLK_PIN);
+	SWCLK_MODE_GPIO();
+}
+
+static uint32_t swdptap_seq_in_spi(const size_t clock_cycles)
+{
+	const size_t bytes = clock_cycles / 8U;
+	/* SWDIO stays a floating GPIO so MOSI never drives it, the data comes in on MISO */
+	memset(swdptap_spi_tx, 0xff, bytes);
+	swdptap_spi_transfer(bytes);
+	uint32_t value = 0;
+	for (size_t byte = 0; byte < bytes; ++byte)
+		value |= (uint32_t)swdptap_spi_rx[byte] << (byte * 8U);
+	if (clock_cycles % 8U)
+		value |= swdptap_seq_in_no_delay(clock_cycles % 8U) << (bytes * 8U);
+	return value;
+}
+
+static void swdptap_seq_out_spi(const uint32_t tms_states, const size_t clock_cycles)
+{
+	const size_t bytes = clock_cycles / 8U;
+	for (size_t byte = 0; byte < bytes; ++byte)
+		swdptap_spi_tx[byte] = (tms_states >> (byte * 8U)) & 0xffU;
+	SWDIO_MODE_SPI();
+	swdptap_spi_transfer(bytes);
+	SWDIO_MODE_DRIVE();
+	if (clock_cycles % 8U)
+		swdptap_seq_out_no_delay(tms_states >> (bytes * 8U), clock_cycles % 8U);
+}
+
+static void swdptap_spi_init(void)
+{
+	rcc_periph_clock_enable(SWD_SPI_RCC);
+	rcc_periph_clock_enable(SWD_SPI_DMA_RCC);
+	SWD_SPI_PIN_SETUP();
+	spi_reset(SWD_SPI);
+	spi_init_master(SWD_SPI, SWD_SPI_BAUDRATE, SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE, SPI_CR1_CPHA_CLK_TRANSITION_1,
+		SPI_CR1_DFF_8BIT, SPI_CR1_LSBFIRST);
+	spi_enable_software_slave_management(SWD_SPI);
+	spi_set_nss_high(SWD_SPI);
+}
+#endif
+
 static void swdptap_seq_out(const uint32_t tms_states, const size_t clock_cycles)
 {
 	swdptap_turnaround(SWDIO_STATUS_DRIVE);
+#ifdef SWD_SPI
+	if (!swd_delay_cnt && clock_cycles >= 8U) {
+		swdptap_seq_out_spi(tms_states, clock_cycles);
+		return;
+	}
+#endif
 	if (swd_delay_cnt)
 		swdptap_seq_out_swd_delay(tms_states, clock_cycles);
 	else
@@ -178,6 +293,9 @@ static void swdptap_seq_out_parity(const uint32_t tms_states, const size_t clock
 
 int swdptap_init(adiv5_debug_port_s *dp)
 {
+#ifdef SWD_SPI
+	swdptap_spi_init();
+#endif
 	dp->seq_in = swdptap_seq_in;
 	dp->seq_in_parity = swdptap_seq_in_parity;
 	dp->seq_out = swdptap_seq_out;
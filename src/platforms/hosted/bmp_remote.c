@@ -34,6 +34,10 @@
 #include <errno.h>
 
 #include "adiv5.h"
+#include "exception.h"
+
+/* Set when the firmware understands REMOTE_AP_MEM_WRITE_LZ */
+static bool remote_mem_write_lz_supported = false;
 
 int remote_init(void)
 {
@@ -144,6 +148,23 @@ void remote_target_clk_output_enable(const bool enable)
 		DEBUG_WARN("remote_target_clk_output_enable failed, error %s\n", length ? buffer + 1 : "unknown");
 }
 
+/*
+ * Re-raise an exception the probe reported for an ADIv5 request, having the link errors among
+ * them step the SWJ clock down just as they would if they had happened here.
+ */
+static void remote_adiv5_check_exception(const char *const response, const int length)
+{
+	if (length < 2 || response[0] != REMOTE_RESP_ERR)
+		return;
+	const uint64_t error = remotehston(16U, response + 1);
+	if ((error & 0xffU) != REMOTE_ERROR_EXCEPTION)
+		return;
+	const uint32_t type = error >> 8U;
+	if (type == EXCEPTION_ERROR)
+		adiv5_dp_link_error("Remote ADIv5 link error");
+	raise_exception(type, "Remote ADIv5 request failed");
+}
+
 static uint32_t remote_adiv5_dp_read(adiv5_debug_port_s *dp, uint16_t addr)
 {
 	(void)dp;
@@ -151,6 +172,7 @@ static uint32_t remote_adiv5_dp_read(adiv5_debug_port_s *dp, uint16_t addr)
 	int s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_DP_READ_STR, dp->dp_jd_index, addr);
 	platform_buffer_write((uint8_t *)construct, s);
 	s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
+	remote_adiv5_check_exception(construct, s);
 	if (s < 1 || construct[0] == REMOTE_RESP_ERR)
 		DEBUG_WARN("%s error %d\n", __func__, s);
 	uint32_t dest;
@@ -166,6 +188,7 @@ static uint32_t remote_adiv5_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uin
 	int s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_LOW_ACCESS_STR, dp->dp_jd_index, RnW, addr, value);
 	platform_buffer_write((uint8_t *)construct, s);
 	s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
+	remote_adiv5_check_exception(construct, s);
 	if (s < 1 || construct[0] == REMOTE_RESP_ERR)
 		DEBUG_WARN("%s error %d\n", __func__, s);
 	uint32_t dest;
@@ -179,6 +202,7 @@ static uint32_t remote_adiv5_ap_read(adiv5_access_port_s *ap, uint16_t addr)
 	int s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_AP_READ_STR, ap->dp->dp_jd_index, ap->apsel, addr);
 	platform_buffer_write((uint8_t *)construct, s);
 	s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
+	remote_adiv5_check_exception(construct, s);
 	if (s < 1 || construct[0] == REMOTE_RESP_ERR)
 		DEBUG_WARN("%s error %d\n", __func__, s);
 	uint32_t dest;
@@ -192,6 +216,7 @@ static void remote_adiv5_ap_write(adiv5_access_port_s *ap, uint16_t addr, uint32
 	int s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_AP_WRITE_STR, ap->dp->dp_jd_index, ap->apsel, addr, value);
 	platform_buffer_write((uint8_t *)construct, s);
 	s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
+	remote_adiv5_check_exception(construct, s);
 	if (s < 1 || construct[0] == REMOTE_RESP_ERR)
 		DEBUG_WARN("%s error %d\n", __func__, s);
 }
@@ -209,6 +234,7 @@ static void remote_ap_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src
 			ap->csw, src + offset, count);
 		platform_buffer_write((uint8_t *)construct, s);
 		s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
+		remote_adiv5_check_exception(construct, s);
 		if (s > 0 && construct[0] == REMOTE_RESP_OK) {
 			unhexify(dest + offset, (const char *)&construct[1], count);
 			continue;
@@ -224,6 +250,97 @@ static void remote_ap_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src
 	}
 }
 
+/*
+ * Greedily compress as much of src as fits in dest_len bytes into the REMOTE_AP_MEM_WRITE_LZ
+ * format, returning how many bytes of src were consumed. The amount consumed is always a
+ * multiple of granularity, so the expanded data can be written with the requested alignment.
+ */
+static size_t remote_lz_compress(
+	const uint8_t *const src, const size_t len, uint8_t *const dest, const size_t dest_len, size_t *const dest_used,
+	const size_t granularity)
+{
+	size_t in = 0;
+	size_t out = 0;
+	/* Where the token for the literal run being built is, and how long that run is so far */
+	size_t literal_token = 0;
+	size_t literals = 0;
+	/* The last point in the stream that ends on a multiple of granularity */
+	size_t checkpoint_in = 0;
+	size_t checkpoint_out = 0;
+	size_t checkpoint_literal_token = 0;
+	size_t checkpoint_literals = 0;
+
+	while (in < len) {
+		size_t match_len = 0;
+		size_t match_distance = 0;
+		const size_t max_len = MIN(len - in, REMOTE_LZ_MAX_MATCH);
+		for (size_t distance = 1; distance <= MIN(in, REMOTE_LZ_WINDOW) && match_len < max_len; ++distance) {
+			size_t length = 0;
+			while (length < max_len && src[in - distance + length] == src[in + length])
+				++length;
+			if (length > match_len) {
+				match_len = length;
+				match_distance = distance;
+			}
+		}
+
+		if (match_len >= REMOTE_LZ_MIN_MATCH) {
+			if (out + 2U > dest_len)
+				break;
+			dest[out++] = REMOTE_LZ_MATCH | (match_len - REMOTE_LZ_MIN_MATCH);
+			dest[out++] = match_distance - 1U;
+			in += match_len;
+			literals = 0;
+		} else {
+			if (out + (literals ? 1U : 2U) > dest_len)
+				break;
+			if (!literals)
+				literal_token = out++;
+			dest[out++] = src[in++];
+			/* Keep the token up to date so the stream is complete after every byte */
+			dest[literal_token] = literals++;
+			if (literals == REMOTE_LZ_MAX_LITERAL)
+				literals = 0;
+		}
+
+		if (in % granularity == 0) {
+			checkpoint_in = in;
+			checkpoint_out = out;
+			checkpoint_literal_token = literal_token;
+			checkpoint_literals = literals;
+		}
+	}
+
+	/* Ran out of space part way through an alignment unit, so wind back to the last whole one */
+	if (in % granularity) {
+		in = checkpoint_in;
+		out = checkpoint_out;
+		if (checkpoint_literals)
+			dest[checkpoint_literal_token] = checkpoint_literals - 1U;
+	}
+	*dest_used = out;
+	return in;
+}
+
+/* Send a memory write request built in construct, returning false if it failed */
+static bool remote_ap_mem_write_request(adiv5_access_port_s *ap, char *construct, size_t length, uint32_t dest)
+{
+	construct[length] = REMOTE_EOM;
+	construct[length + 1U] = '\0';
+	platform_buffer_write((uint8_t *)construct, length + 2U);
+
+	const int s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
+	remote_adiv5_check_exception(construct, s);
+	if (s > 0 && construct[0] == REMOTE_RESP_OK)
+		return true;
+	if (s > 0 && construct[0] == REMOTE_RESP_ERR) {
+		ap->dp->fault = 1;
+		DEBUG_WARN("%s returned REMOTE_RESP_ERR at apsel %u, addr: 0x%08zx\n", __func__, ap->apsel, (size_t)dest);
+	}
+	DEBUG_WARN("%s error %d around address 0x%08zx\n", __func__, s, (size_t)dest);
+	return false;
+}
+
 static void remote_ap_mem_write_sized(
 	adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align)
 {
@@ -232,48 +349,82 @@ static void remote_ap_mem_write_sized(
 		return;
 	char construct[REMOTE_MAX_MSG_SIZE];
 	/* (5 * 1 (char)) + (2 * 2 (bytes)) + (3 * 8 (words)) */
-	size_t batchsize = (REMOTE_MAX_MSG_SIZE - 0x30U) / 2U;
-	const char *data = (const char *)src;
-	for (size_t offset = 0; offset < len; offset += batchsize) {
-		const size_t count = MIN(len - offset, batchsize);
-		int s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_AP_MEM_WRITE_SIZED_STR, ap->dp->dp_jd_index, ap->apsel,
-			ap->csw, align, dest + offset, count);
-		assert(s > 0);
-		hexify(construct + s, data + offset, count);
-		const size_t hex_length = s + (count * 2U);
-		construct[hex_length] = REMOTE_EOM;
-		construct[hex_length + 1U] = '\0';
-		platform_buffer_write((uint8_t *)construct, hex_length + 2U);
+	const size_t batchsize = (REMOTE_MAX_MSG_SIZE - 0x30U) / 2U;
+	const uint8_t *data = (const uint8_t *)src;
+	uint8_t packed[batchsize];
+	for (size_t offset = 0; offset < len;) {
+		size_t count = MIN(len - offset, batchsize);
+		size_t packed_len = 0;
+		/* Only send the data compressed when that gets more of it across than sending it as-is */
+		if (remote_mem_write_lz_supported) {
+			const size_t packed_count =
+				remote_lz_compress(data + offset, len - offset, packed, batchsize, &packed_len, 1U << align);
+			if (packed_count > count)
+				count = packed_count;
+			else
+				packed_len = 0;
+		}
 
-		s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
-		if (s > 0 && construct[0] == REMOTE_RESP_OK)
-			continue;
-		if (s > 0 && construct[0] == REMOTE_RESP_ERR) {
-			ap->dp->fault = 1;
-			DEBUG_WARN(
-				"%s returned REMOTE_RESP_ERR at apsel %u, addr: 0x%08zx\n", __func__, ap->apsel, (size_t)dest + offset);
+		int s;
+		if (packed_len) {
+			s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_AP_MEM_WRITE_LZ_STR, ap->dp->dp_jd_index, ap->apsel,
+				ap->csw, align, dest + offset, count);
+			assert(s > 0);
+			hexify(construct + s, packed, packed_len);
+			s += packed_len * 2U;
+		} else {
+			s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_AP_MEM_WRITE_SIZED_STR, ap->dp->dp_jd_index,
+				ap->apsel, ap->csw, align, dest + offset, count);
+			assert(s > 0);
+			hexify(construct + s, data + offset, count);
+			s += count * 2U;
 		}
-		DEBUG_WARN("%s error %d around address 0x%08zx\n", __func__, s, (size_t)dest + offset);
-		break;
+		if (!remote_ap_mem_write_request(ap, construct, s, dest + offset))
+			break;
+		offset += count;
 	}
 }
 
+static bool remote_ap_mem_poll32(adiv5_access_port_s *const ap, const uint32_t address, const uint32_t mask,
+	const uint32_t value, const uint32_t timeout)
+{
+	char construct[REMOTE_MAX_MSG_SIZE];
+	int s = snprintf(construct, REMOTE_MAX_MSG_SIZE, REMOTE_AP_MEM_POLL32_STR, ap->dp->dp_jd_index, ap->apsel, ap->csw,
+		address, mask, value, timeout);
+	platform_buffer_write((uint8_t *)construct, s);
+	s = platform_buffer_read((uint8_t *)construct, REMOTE_MAX_MSG_SIZE);
+	remote_adiv5_check_exception(construct, s);
+	if (s > 0 && construct[0] == REMOTE_RESP_OK)
+		return construct[1] == '1';
+	if (construct[0] == REMOTE_RESP_ERR) {
+		ap->dp->fault = 1;
+		DEBUG_WARN("%s returned REMOTE_RESP_ERR at apsel %u, addr: 0x%08" PRIx32 "\n", __func__, ap->apsel, address);
+	} else
+		DEBUG_WARN("%s error %d around 0x%08" PRIx32 "\n", __func__, s, address);
+	return false;
+}
+
 void remote_adiv5_dp_defaults(adiv5_debug_port_s *dp)
 {
 	uint8_t construct[REMOTE_MAX_MSG_SIZE];
 	int s = snprintf((char *)construct, REMOTE_MAX_MSG_SIZE, "%s", REMOTE_HL_CHECK_STR);
 	platform_buffer_write(construct, s);
 	s = platform_buffer_read(construct, REMOTE_MAX_MSG_SIZE);
-	if (s < 1 || construct[0] == REMOTE_RESP_ERR || construct[1] - '0' < REMOTE_HL_VERSION) {
+	if (s < 1 || construct[0] == REMOTE_RESP_ERR || construct[1] - '0' < REMOTE_HL_VERSION_MIN) {
 		DEBUG_WARN("Please update BMP firmware for substantial speed increase!\n");
 		return;
 	}
+	remote_mem_write_lz_supported = construct[1] - '0' >= REMOTE_LZ_HL_VERSION;
 	dp->low_access = remote_adiv5_low_access;
 	dp->dp_read = remote_adiv5_dp_read;
 	dp->ap_write = remote_adiv5_ap_write;
 	dp->ap_read = remote_adiv5_ap_read;
 	dp->mem_read = remote_ap_mem_read;
 	dp->mem_write_sized = remote_ap_mem_write_sized;
+	if (construct[1] - '0' >= REMOTE_POLL_HL_VERSION) {
+		dp->mem_poll32 = remote_ap_mem_poll32;
+		dp->mem_poll32_on_probe = true;
+	}
 }
 
 void remote_add_jtag_dev(uint32_t i, const jtag_dev_s *jtag_dev)
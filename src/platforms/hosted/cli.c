@@ -175,7 +175,8 @@ static void cl_help(char **argv)
 			   "\t                   complete command\n"
 			   "\n"
 			   "SWD-specific configuration options [-f FREQUENCY | -m TARGET]:\n"
-			   "\t-f, --freq       Set an operating frequency for SWD\n"
+			   "\t-f, --freq       Set an operating frequency for SWD, or 'auto' to find the\n"
+			   "\t                   highest the link to the target works at once attached\n"
 			   "\t-m, --mult-drop  Use the given target ID for selection in SWD multi-drop\n"
 			   "\n"
 			   "Flash operation selection options [-E | -w | -V | -r]:\n"
@@ -191,7 +192,13 @@ static void cl_help(char **argv)
 			   "\t                   the start of Flash)\n"
 			   "\t-S, --byte-count Number of bytes to work on in the Flash operation (default\n"
 			   "\t                   is till the operation fails or is complete)\n"
-			   "\t<file>           Binary file to use in Flash operations\n",
+			   "\t<file>           Binary file to use in Flash operations\n"
+			   "\n"
+			   "Profiling options [-G MS] [FILE]:\n"
+			   "\t-G, --profile    Sample the running core's PC for the given number of\n"
+			   "\t                   milliseconds (Cortex-M with DWT_PCSR only). Writes a gprof\n"
+			   "\t                   histogram if FILE ends in .out, folded stacks otherwise, and\n"
+			   "\t                   prints the folded stacks if no FILE is given\n",
 		argv[0]);
 	exit(0);
 }
@@ -224,6 +231,7 @@ static const getopt_option_s long_options[] = {
 	{"read", no_argument, NULL, 'r'},
 	{"addr", required_argument, NULL, 'a'},
 	{"byte-count", required_argument, NULL, 'S'},
+	{"profile", required_argument, NULL, 'G'},
 	{NULL, 0, NULL, 0},
 };
 
@@ -236,7 +244,7 @@ void cl_init(bmda_cli_options_s *opt, int argc, char **argv)
 	opt->opt_scanmode = BMP_SCAN_SWD;
 	opt->opt_mode = BMP_MODE_DEBUG;
 	while (true) {
-		const int option = getopt_long(argc, argv, "eEFhHv:d:f:s:I:c:Cln:m:M:wVtTa:S:jApP:rR::", long_options, NULL);
+		const int option = getopt_long(argc, argv, "eEFhHv:d:f:s:I:c:Cln:m:M:wVtTa:S:jApP:rR::G:", long_options, NULL);
 		if (option == -1)
 			break;
 
@@ -280,7 +288,9 @@ void cl_init(bmda_cli_options_s *opt, int argc, char **argv)
 			opt->fast_poll = true;
 			break;
 		case 'f':
-			if (optarg) {
+			if (optarg && !strcmp(optarg, "auto"))
+				opt->opt_tune_swj_frequency = true;
+			else if (optarg) {
 				char *p;
 				uint32_t frequency = strtol(optarg, &p, 10);
 				switch (*p) {
@@ -336,6 +346,11 @@ void cl_init(bmda_cli_options_s *opt, int argc, char **argv)
 		case 'p':
 			opt->opt_tpwr = true;
 			break;
+		case 'G':
+			opt->opt_mode = BMP_MODE_PROFILE;
+			if (optarg)
+				opt->opt_profile_duration = strtoul(optarg, NULL, 0);
+			break;
 		case 'a':
 			if (optarg)
 				opt->opt_flash_start = strtol(optarg, NULL, 0);
@@ -505,6 +520,13 @@ found_targets:
 	if (opt->opt_flash_size == 0xffffffffU && opt->opt_mode != BMP_MODE_FLASH_WRITE &&
 		opt->opt_mode != BMP_MODE_FLASH_VERIFY && opt->opt_mode != BMP_MODE_FLASH_WRITE_VERIFY)
 		opt->opt_flash_size = lowest_flash_size;
+	if (opt->opt_tune_swj_frequency) {
+		const uint32_t frequency = target_swj_frequency_tune(t);
+		if (frequency)
+			DEBUG_INFO("SWJ frequency tuned to %" PRIu32 "Hz\n", frequency);
+		else
+			DEBUG_WARN("SWJ frequency tuning failed or is not supported\n");
+	}
 	if (opt->opt_mode == BMP_MODE_SWJ_TEST) {
 		/*
 		 * XXX: This is bugprone - any core, even if it's not just a Cortex-M* that
@@ -549,6 +571,23 @@ found_targets:
 		if (res)
 			DEBUG_WARN("Command \"%s\" failed\n", opt->opt_monitor);
 	}
+	if (opt->opt_mode == BMP_MODE_PROFILE) {
+		/* Hand over to the target's profile monitor command, picking the output format by file extension */
+		const char *const file = opt->opt_flash_file;
+		const size_t file_len = file ? strlen(file) : 0U;
+		const bool gmon = file_len > 4U && !strcmp(file + file_len - 4U, ".out");
+		char command[512];
+		const int command_len = snprintf(command, sizeof(command), "profile %" PRIu32 " %s %s",
+			opt->opt_profile_duration, gmon ? "gmon" : "folded", file ? file : "");
+		if (command_len < 0 || (size_t)command_len >= sizeof(command)) {
+			DEBUG_WARN("Profile file name too long\n");
+			res = -1;
+		} else if (command_process(t, command)) {
+			DEBUG_WARN("Profiling failed, is this a Cortex-M target with DWT_PCSR?\n");
+			res = -1;
+		}
+		goto free_map;
+	}
 	if (opt->opt_mode == BMP_MODE_RESET)
 		target_reset(t);
 	else if (opt->opt_mode == BMP_MODE_FLASH_ERASE) {
@@ -562,8 +601,9 @@ found_targets:
 	} else if (opt->opt_mode == BMP_MODE_FLASH_WRITE || opt->opt_mode == BMP_MODE_FLASH_WRITE_VERIFY) {
 		DEBUG_INFO("Erasing  %zu bytes at 0x%08" PRIx32 "\n", map.size, opt->opt_flash_start);
 		const uint32_t start_time = platform_time_ms();
-		if (!target_flash_erase(t, opt->opt_flash_start, map.size)) {
+		if (!target_flash_erase_lazy(t, opt->opt_flash_start, map.size)) {
 			DEBUG_WARN("Erasure failed!\n");
+			target_flash_complete(t);
 			res = -1;
 			goto free_map;
 		}
@@ -38,6 +38,7 @@ typedef enum bmda_cli_mode {
 	BMP_MODE_FLASH_VERIFY,
 	BMP_MODE_SWJ_TEST,
 	BMP_MODE_MONITOR,
+	BMP_MODE_PROFILE,
 } bmda_cli_mode_e;
 
 typedef enum bmp_scan_mode {
@@ -55,6 +56,7 @@ typedef struct bmda_cli_options {
 	bool external_resistor_swd;
 	bool fast_poll;
 	bool opt_no_hl;
+	bool opt_tune_swj_frequency;
 	char *opt_flash_file;
 	char *opt_device;
 	char *opt_serial;
@@ -68,6 +70,7 @@ typedef struct bmda_cli_options {
 	uint32_t opt_flash_start;
 	uint32_t opt_max_swj_frequency;
 	size_t opt_flash_size;
+	uint32_t opt_profile_duration;
 } bmda_cli_options_s;
 
 void cl_init(bmda_cli_options_s *opt, int argc, char **argv);
@@ -533,6 +533,8 @@ void dap_adiv5_dp_defaults(adiv5_debug_port_s *dp)
 	dp->ap_write = dap_ap_write;
 	dp->mem_read = dap_mem_read;
 	dp->mem_write_sized = dap_mem_write_sized;
+	dp->mem_poll32 = dap_mem_poll32;
+	dp->mem_poll32_on_probe = true;
 }
 
 static void cmsis_dap_jtagtap_reset(void)
@@ -315,7 +315,7 @@ static uint32_t wait_word(uint8_t *buf, size_t response_length, size_t request_l
 	}
 
 	if (buf[1] != SWDP_ACK_OK)
-		raise_exception(EXCEPTION_ERROR, "SWDP invalid ACK");
+		adiv5_dp_link_error("SWDP invalid ACK");
 	uint32_t res = ((uint32_t)buf[5] << 24U) | ((uint32_t)buf[4] << 16U) | ((uint32_t)buf[3] << 8U) | (uint32_t)buf[2];
 	return res;
 }
@@ -607,6 +607,39 @@ void dap_write_single(adiv5_access_port_s *ap, uint32_t dest, const void *src, a
 		DEBUG_WARN("dap_write_single failed (fault = %u)\n", dp->fault);
 }
 
+bool dap_mem_poll32(adiv5_access_port_s *const ap, const uint32_t addr, const uint32_t mask, const uint32_t value,
+	const uint32_t timeout)
+{
+	dap_transfer_request_s requests[5];
+	/* Point TAR at the location with auto-increment off so DRW can be re-read */
+	requests[0].request = SWD_DP_W_SELECT;
+	requests[0].data = SWD_DP_REG(ADIV5_AP_CSW & 0xf0U, ap->apsel);
+	requests[1].request = SWD_AP_CSW;
+	requests[1].data = ap->csw | ADIV5_AP_CSW_ADDRINC_NONE | ADIV5_AP_CSW_SIZE_WORD;
+	requests[2].request = SWD_AP_TAR;
+	requests[2].data = addr;
+	/* Load the match mask, then have the adaptor re-read DRW until it matches or runs out of match retries */
+	requests[3].request = DAP_TRANSFER_MATCH_MASK;
+	requests[3].data = mask;
+	requests[4].request = SWD_AP_DRW | DAP_TRANSFER_RnW | DAP_TRANSFER_MATCH_VALUE;
+	requests[4].data = value;
+
+	adiv5_debug_port_s *const dp = ap->dp;
+	platform_timeout_s poll_timeout;
+	platform_timeout_set(&poll_timeout, timeout);
+	while (!perform_dap_transfer_recoverable(dp, requests, 5U, NULL, 0U)) {
+		/* Anything other than the value not matching yet is a real failure */
+		if (!(dp->fault & DAP_TRANSFER_MISMATCH)) {
+			DEBUG_WARN("dap_mem_poll32 failed (fault = %u)\n", dp->fault);
+			return false;
+		}
+		dp->fault = 0;
+		if (platform_timeout_is_expired(&poll_timeout))
+			return false;
+	}
+	return true;
+}
+
 void dap_jtagtap_tdi_tdo_seq(
 	uint8_t *data_out, bool const final_tms, const uint8_t *tms, const uint8_t *data_in, size_t ticks)
 {
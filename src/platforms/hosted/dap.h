@@ -82,6 +82,7 @@ uint32_t dap_ap_read(adiv5_access_port_s *ap, uint16_t addr);
 void dap_ap_write(adiv5_access_port_s *ap, uint16_t addr, uint32_t value);
 void dap_read_single(adiv5_access_port_s *ap, void *dest, uint32_t src, align_e align);
 void dap_write_single(adiv5_access_port_s *ap, uint32_t dest, const void *src, align_e align);
+bool dap_mem_poll32(adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout);
 ssize_t dbg_dap_cmd(uint8_t *data, size_t response_length, size_t request_length);
 bool dap_run_cmd(const void *request_data, size_t request_length, void *response_data, size_t response_length);
 void dap_jtagtap_tdi_tdo_seq(
@@ -37,6 +37,8 @@ static uint32_t jlink_adiv5_swdp_read_nocheck(uint16_t addr);
 static uint32_t jlink_adiv5_swdp_error(adiv5_debug_port_s *dp, bool protocol_recovery);
 static uint32_t jlink_adiv5_swdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_t addr, uint32_t value);
 static void jlink_adiv5_swdp_abort(adiv5_debug_port_s *dp, uint32_t abort);
+static size_t jlink_swd_batch_units(bool write);
+static size_t jlink_swd_run_batch(uint32_t addr, uint32_t *values, size_t count, bool write, uint8_t *ack);
 
 /*
  * Write at least 50 bits high, two bits low and read DP_IDR and put
@@ -128,6 +130,10 @@ uint32_t jlink_swdp_scan(bmp_info_s *const info)
 	dp->error = jlink_adiv5_swdp_error;
 	dp->low_access = jlink_adiv5_swdp_low_access;
 	dp->abort = jlink_adiv5_swdp_abort;
+	dp->batch_units = jlink_swd_batch_units;
+	dp->run_batch = jlink_swd_run_batch;
+	dp->mem_read = adiv5_batch_mem_read;
+	dp->mem_write_sized = adiv5_batch_mem_write_sized;
 
 	adiv5_dp_error(dp);
 	adiv5_dp_init(dp, 0);
@@ -259,7 +265,7 @@ static uint32_t jlink_adiv5_swdp_low_read(adiv5_debug_port_s *const dp)
 	{
 		dp->fault = 1;
 		DEBUG_WARN("SWD access resulted in parity error\n");
-		raise_exception(EXCEPTION_ERROR, "SWD parity error");
+		adiv5_dp_link_error("SWD parity error");
 	}
 	return response;
 }
@@ -328,7 +334,7 @@ static uint32_t jlink_adiv5_swdp_low_access(
 
 	if (ack != SWDP_ACK_OK) {
 		DEBUG_WARN("SWD access has invalid ack %x\n", ack);
-		raise_exception(EXCEPTION_ERROR, "SWD invalid ACK");
+		adiv5_dp_link_error("SWD invalid ACK");
 	}
 
 	/* Always append 8 idle cycles (SWDIO = 0)! */
@@ -342,3 +348,137 @@ static void jlink_adiv5_swdp_abort(adiv5_debug_port_s *const dp, const uint32_t
 {
 	adiv5_dp_write(dp, ADIV5_DP_ABORT, abort);
 }
+
+/*
+ * Batched block transfers.
+ *
+ * Memory accesses are encoded as one long CMD_HW_JTAG3 sequence holding a TAR write, a run of
+ * DRW accesses and a trailing RDBUFF read, and all the ACKs and data are picked out of the
+ * returned bitstream afterwards. adiv5_batch_mem_read() and adiv5_batch_mem_write_sized() run
+ * these with overrun detection on, so the data phase is always clocked.
+ *
+ * The per-transaction bit patterns are the same as the ones low_access uses above, including
+ * the J-Link sampling SWDIO one cycle early, so the ACK always lands 8 bits into a transaction.
+ */
+
+#define JLINK_SWD_READ_CYCLES  46U
+#define JLINK_SWD_WRITE_CYCLES 54U
+/* Largest sequence the J-Link firmware buffers in one go, in bytes per direction */
+#define JLINK_SWD_BATCH_BYTES  2048U
+
+typedef struct jlink_swd_batch {
+	size_t cycles;
+	uint8_t cmd[4U + (2U * JLINK_SWD_BATCH_BYTES)];
+	uint8_t direction[JLINK_SWD_BATCH_BYTES];
+	uint8_t data[JLINK_SWD_BATCH_BYTES];
+	uint8_t result[JLINK_SWD_BATCH_BYTES + 1U];
+} jlink_swd_batch_s;
+
+static jlink_swd_batch_s jlink_swd_batch;
+
+static void jlink_swd_batch_bits(const size_t count, const bool out, const uint32_t value)
+{
+	for (size_t i = 0; i < count; ++i) {
+		const size_t cycle = jlink_swd_batch.cycles++;
+		const uint8_t mask = 1U << (cycle & 7U);
+		if (out)
+			jlink_swd_batch.direction[cycle >> 3U] |= mask;
+		if (value & (1U << i))
+			jlink_swd_batch.data[cycle >> 3U] |= mask;
+	}
+}
+
+static uint32_t jlink_swd_batch_result(const size_t start, const size_t count)
+{
+	uint32_t value = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const size_t cycle = start + i;
+		if (jlink_swd_batch.result[cycle >> 3U] & (1U << (cycle & 7U)))
+			value |= 1U << i;
+	}
+	return value;
+}
+
+static void jlink_swd_batch_read(const uint16_t addr)
+{
+	/* 8 request bits, turnaround, ACK, data and parity in, then turnaround and an idle cycle */
+	jlink_swd_batch_bits(8U, true, make_packet_request(ADIV5_LOW_READ, addr));
+	jlink_swd_batch_bits(4U, false, 0U);
+	jlink_swd_batch_bits(32U, false, 0U);
+	jlink_swd_batch_bits(2U, true, 0U);
+}
+
+static void jlink_swd_batch_write(const uint16_t addr, const uint32_t value)
+{
+	/* 8 request bits, turnaround and ACK in, then turnaround, data, parity and 8 idle cycles */
+	jlink_swd_batch_bits(8U, true, make_packet_request(ADIV5_LOW_WRITE, addr));
+	jlink_swd_batch_bits(4U, false, 0U);
+	jlink_swd_batch_bits(1U, true, 0U);
+	jlink_swd_batch_bits(32U, true, value);
+	jlink_swd_batch_bits(9U, true, __builtin_parity(value) & 1U);
+}
+
+static size_t jlink_swd_batch_units(const bool write)
+{
+	/* Every batch carries a TAR write and a trailing RDBUFF read */
+	const size_t overhead = JLINK_SWD_WRITE_CYCLES + JLINK_SWD_READ_CYCLES;
+	return ((JLINK_SWD_BATCH_BYTES * 8U) - overhead) / (write ? JLINK_SWD_WRITE_CYCLES : JLINK_SWD_READ_CYCLES);
+}
+
+/*
+ * Run one batch of `count` DRW accesses starting at addr as a single USB transaction.
+ * Returns how many transfers got an OK ACK, with *ack set to the first failure.
+ */
+static size_t jlink_swd_run_batch(
+	const uint32_t addr, uint32_t *const values, const size_t count, const bool write, uint8_t *const ack)
+{
+	jlink_swd_batch.cycles = 0;
+	memset(jlink_swd_batch.direction, 0, sizeof(jlink_swd_batch.direction));
+	memset(jlink_swd_batch.data, 0, sizeof(jlink_swd_batch.data));
+	jlink_swd_batch_write(ADIV5_AP_TAR, addr);
+	for (size_t i = 0; i < count; ++i) {
+		if (write)
+			jlink_swd_batch_write(ADIV5_AP_DRW, values[i]);
+		else
+			jlink_swd_batch_read(ADIV5_AP_DRW);
+	}
+	jlink_swd_batch_read(ADIV5_DP_RDBUFF);
+
+	const size_t cycles = jlink_swd_batch.cycles;
+	const size_t bytes = (cycles + 7U) >> 3U;
+	uint8_t *const cmd = jlink_swd_batch.cmd;
+	cmd[0] = CMD_HW_JTAG3;
+	cmd[1] = 0;
+	cmd[2] = cycles & 0xffU;
+	cmd[3] = cycles >> 8U;
+	memcpy(cmd + 4U, jlink_swd_batch.direction, bytes);
+	memcpy(cmd + 4U + bytes, jlink_swd_batch.data, bytes);
+	send_recv(info.usb_link, cmd, 4U + (2U * bytes), jlink_swd_batch.result, bytes);
+	send_recv(info.usb_link, NULL, 0U, jlink_swd_batch.result + bytes, 1U);
+	if (jlink_swd_batch.result[bytes] != 0)
+		raise_exception(EXCEPTION_ERROR, "Low access batch failed");
+
+	const size_t transfers = count + 2U;
+	size_t start = 0;
+	for (size_t transfer = 0; transfer < transfers; ++transfer) {
+		const bool is_read = transfer == transfers - 1U || (transfer && !write);
+		const uint8_t transfer_ack = jlink_swd_batch_result(start + 8U, 3U);
+		const size_t data_start = start + 11U;
+		start += is_read ? JLINK_SWD_READ_CYCLES : JLINK_SWD_WRITE_CYCLES;
+		if (transfer_ack != SWDP_ACK_OK) {
+			*ack = transfer_ack;
+			return transfer;
+		}
+		if (!is_read)
+			continue;
+		const uint32_t value = jlink_swd_batch_result(data_start, 32U);
+		if ((__builtin_parity(value) & 1U) != jlink_swd_batch_result(data_start + 32U, 1U)) {
+			*ack = ADIV5_BATCH_PARITY_ERROR;
+			return transfer;
+		}
+		/* Reads are posted, so each one returns the data of the unit before it */
+		if (!write && transfer >= 2U)
+			values[transfer - 2U] = value;
+	}
+	return transfers;
+}
@@ -46,6 +46,8 @@ static bool swdptap_seq_in_parity(uint32_t *res, size_t clock_cycles);
 static uint32_t swdptap_seq_in(size_t clock_cycles);
 static void swdptap_seq_out(uint32_t tms_states, size_t clock_cycles);
 static void swdptap_seq_out_parity(uint32_t tms_states, size_t clock_cycles);
+static size_t swdptap_mpsse_batch_units(bool write);
+static size_t swdptap_mpsse_run_batch(uint32_t addr, uint32_t *values, size_t count, bool write, uint8_t *ack);
 
 bool libftdi_swd_possible(void)
 {
@@ -115,6 +117,12 @@ int libftdi_swdptap_init(adiv5_debug_port_s *dp)
 	dp->error = firmware_swdp_error;
 	dp->low_access = firmware_swdp_low_access;
 	dp->abort = firmware_swdp_abort;
+	if (do_mpsse) {
+		dp->batch_units = swdptap_mpsse_batch_units;
+		dp->run_batch = swdptap_mpsse_run_batch;
+		dp->mem_read = adiv5_batch_mem_read;
+		dp->mem_write_sized = adiv5_batch_mem_write_sized;
+	}
 	return 0;
 }
 
@@ -479,3 +487,151 @@ static void swdptap_seq_out_parity(uint32_t tms_states, size_t clock_cycles)
 	else
 		swdptap_seq_out_parity_raw(tms_states, parity, clock_cycles);
 }
+
+/*
+ * Batched block transfers for genuine MPSSE.
+ *
+ * Going through firmware_swdp_low_access() costs a full USB round trip per transfer, as the ACK
+ * has to be read back before the data phase can be decided on. For block memory accesses
+ * adiv5_batch_mem_read() and adiv5_batch_mem_write_sized() turn on overrun detection, which makes
+ * the data phase unconditional, so we can queue a whole batch of transfers into the MPSSE command
+ * buffer and then read back all the ACKs and data in one go.
+ */
+
+/* Response bytes for a write (ACK only) and a read (ACK, 4 data bytes and parity) */
+#define SWDP_MPSSE_WRITE_RESPONSE 1U
+#define SWDP_MPSSE_READ_RESPONSE  6U
+/* Largest chip-to-host FIFO of the MPSSE-capable parts, the FT232H's */
+#define SWDP_MPSSE_FIFO_MAX       1024U
+
+static uint8_t swdp_mpsse_response[SWDP_MPSSE_FIFO_MAX];
+
+/*
+ * The whole batch's responses must fit in the chip's read FIFO, otherwise the MPSSE engine
+ * stalls while we are still blocked writing the rest of the commands.
+ */
+static size_t swdptap_mpsse_fifo_size(void)
+{
+	switch (ftdic->type) {
+	case TYPE_2232H:
+	case TYPE_4232H:
+	case TYPE_232H:
+		return SWDP_MPSSE_FIFO_MAX;
+	default:
+		return 128U;
+	}
+}
+
+static void swdptap_mpsse_queue_request(const uint8_t request)
+{
+	swdptap_turnaround(SWDIO_STATUS_DRIVE);
+	const uint8_t cmd[4] = {
+		MPSSE_DO_WRITE | MPSSE_LSB | MPSSE_WRITE_NEG,
+		0U,
+		0U,
+		request,
+	};
+	libftdi_buffer_write_arr(cmd);
+	swdptap_turnaround(SWDIO_STATUS_FLOAT);
+	/* Clock in the 3 ACK bits, which land in the top of the response byte */
+	const uint8_t ack[2] = {
+		MPSSE_DO_READ | MPSSE_LSB | MPSSE_BITMODE,
+		2U,
+	};
+	libftdi_buffer_write_arr(ack);
+}
+
+static void swdptap_mpsse_queue_read(const uint16_t addr)
+{
+	swdptap_mpsse_queue_request(make_packet_request(ADIV5_LOW_READ, addr));
+	/* 32 data bits followed by the parity bit */
+	const uint8_t cmd[5] = {
+		MPSSE_DO_READ | MPSSE_LSB,
+		3U,
+		0U,
+		MPSSE_DO_READ | MPSSE_LSB | MPSSE_BITMODE,
+		0U,
+	};
+	libftdi_buffer_write_arr(cmd);
+}
+
+static void swdptap_mpsse_queue_write(const uint16_t addr, const uint32_t value)
+{
+	swdptap_mpsse_queue_request(make_packet_request(ADIV5_LOW_WRITE, addr));
+	swdptap_turnaround(SWDIO_STATUS_DRIVE);
+	const uint8_t cmd[10] = {
+		MPSSE_DO_WRITE | MPSSE_LSB | MPSSE_WRITE_NEG,
+		3U,
+		0U,
+		value & 0xffU,
+		(value >> 8U) & 0xffU,
+		(value >> 16U) & 0xffU,
+		(value >> 24U) & 0xffU,
+		MPSSE_TDO_SHIFT,
+		0U,
+		__builtin_parity(value) & 1U,
+	};
+	libftdi_buffer_write_arr(cmd);
+}
+
+static size_t swdptap_mpsse_batch_units(const bool write)
+{
+	/* Every batch carries a TAR write and a trailing RDBUFF read */
+	const size_t overhead = SWDP_MPSSE_WRITE_RESPONSE + SWDP_MPSSE_READ_RESPONSE;
+	return (swdptap_mpsse_fifo_size() - overhead) / (write ? SWDP_MPSSE_WRITE_RESPONSE : SWDP_MPSSE_READ_RESPONSE);
+}
+
+/*
+ * Run one batch: a TAR write, `count` DRW accesses and a RDBUFF read, executed with a single
+ * write/read pair on the USB. Returns how many transfers got an OK ACK, with *ack set to the
+ * first failure.
+ */
+static size_t swdptap_mpsse_run_batch(
+	const uint32_t addr, uint32_t *const values, const size_t count, const bool write, uint8_t *const ack)
+{
+	swdptap_mpsse_queue_write(ADIV5_AP_TAR, addr);
+	for (size_t i = 0; i < count; ++i) {
+		if (write)
+			swdptap_mpsse_queue_write(ADIV5_AP_DRW, values[i]);
+		else
+			swdptap_mpsse_queue_read(ADIV5_AP_DRW);
+	}
+	swdptap_mpsse_queue_read(ADIV5_DP_RDBUFF);
+	/* Finish with the 8 idle cycles needed to clock the last transfer through */
+	swdptap_turnaround(SWDIO_STATUS_DRIVE);
+	const uint8_t idle[3] = {
+		MPSSE_TDO_SHIFT,
+		7U,
+		0U,
+	};
+	libftdi_buffer_write_arr(idle);
+
+	const size_t transfers = count + 2U;
+	const size_t response_len = SWDP_MPSSE_WRITE_RESPONSE + SWDP_MPSSE_READ_RESPONSE +
+		count * (write ? SWDP_MPSSE_WRITE_RESPONSE : SWDP_MPSSE_READ_RESPONSE);
+	libftdi_buffer_read(swdp_mpsse_response, response_len);
+
+	size_t offset = 0;
+	for (size_t transfer = 0; transfer < transfers; ++transfer) {
+		const uint8_t *const response = swdp_mpsse_response + offset;
+		const bool is_read = transfer == transfers - 1U || (transfer && !write);
+		offset += is_read ? SWDP_MPSSE_READ_RESPONSE : SWDP_MPSSE_WRITE_RESPONSE;
+		const uint8_t transfer_ack = response[0] >> 5U;
+		if (transfer_ack != SWDP_ACK_OK) {
+			*ack = transfer_ack;
+			return transfer;
+		}
+		if (!is_read)
+			continue;
+		const uint32_t value = response[1] | ((uint32_t)response[2] << 8U) | ((uint32_t)response[3] << 16U) |
+			((uint32_t)response[4] << 24U);
+		if ((__builtin_parity(value) & 1U) != (response[5] >> 7U)) {
+			*ack = ADIV5_BATCH_PARITY_ERROR;
+			return transfer;
+		}
+		/* Reads are posted, so each one returns the data of the unit before it */
+		if (!write && transfer >= 2U)
+			values[transfer - 2U] = value;
+	}
+	return transfers;
+}
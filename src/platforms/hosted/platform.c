@@ -673,6 +673,14 @@ void adiv5_mem_write_sized(adiv5_access_port_s *ap, uint32_t dest, const void *s
 	return ap->dp->mem_write_sized(ap, dest, src, len, align);
 }
 
+bool adiv5_mem_poll32(adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout)
+{
+	const bool matched = ap->dp->mem_poll32(ap, addr, mask, value, timeout);
+	DEBUG_TARGET("ap_mem_poll32 @ %" PRIx32 " mask %08" PRIx32 " value %08" PRIx32 ": %s\n", addr, mask, value,
+		matched ? "matched" : "timed out");
+	return matched;
+}
+
 void adiv5_dp_abort(adiv5_debug_port_s *dp, uint32_t abort)
 {
 	DEBUG_TARGET("Abort: %08" PRIx32 "\n", abort);
@@ -271,6 +271,8 @@ static int stlink_usb_error_check(uint8_t *data, bool verbose)
 	case STLINK_SWD_AP_PARITY_ERROR:
 		if (verbose)
 			DEBUG_WARN("STLINK_SWD_AP_PARITY_ERROR\n");
+		/* The adaptor saw a corrupted transfer, so step an automatically tuned clock down */
+		target_swj_frequency_backoff();
 		return STLINK_ERROR_FAIL;
 	case STLINK_SWD_DP_FAULT:
 		if (verbose)
@@ -284,6 +286,8 @@ static int stlink_usb_error_check(uint8_t *data, bool verbose)
 	case STLINK_SWD_DP_PARITY_ERROR:
 		if (verbose)
 			DEBUG_WARN("STLINK_SWD_DP_PARITY_ERROR\n");
+		/* The adaptor saw a corrupted transfer, so step an automatically tuned clock down */
+		target_swj_frequency_backoff();
 		return STLINK_ERROR_FAIL;
 	case STLINK_SWD_AP_WDATA_ERROR:
 		if (verbose)
@@ -791,7 +795,7 @@ uint32_t stlink_dp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_t addr
 		return 0;
 	}
 	if (res == STLINK_ERROR_FAIL)
-		raise_exception(EXCEPTION_ERROR, "SWDP invalid ACK");
+		adiv5_dp_link_error("SWDP invalid ACK");
 
 	return response;
 }
@@ -1060,6 +1064,22 @@ int stlink_jtag_dp_init(adiv5_debug_port_s *dp)
 	return true;
 }
 
+/* The ST-Link's DP register access can't re-read DRW, so poll through whole memory reads */
+static bool stlink_mem_poll32(adiv5_access_port_s *const ap, const uint32_t addr, const uint32_t mask,
+	const uint32_t value, const uint32_t timeout)
+{
+	platform_timeout_s poll_timeout;
+	platform_timeout_set(&poll_timeout, timeout);
+	while (true) {
+		uint32_t result = 0;
+		stlink_readmem(ap, &result, addr, sizeof(result));
+		if ((result & mask) == value)
+			return true;
+		if (ap->dp->fault || platform_timeout_is_expired(&poll_timeout))
+			return false;
+	}
+}
+
 void stlink_adiv5_dp_defaults(adiv5_debug_port_s *dp)
 {
 	dp->ap_regs_read = stlink_regs_read;
@@ -1071,6 +1091,7 @@ void stlink_adiv5_dp_defaults(adiv5_debug_port_s *dp)
 	dp->ap_read = stlink_ap_read;
 	dp->mem_read = stlink_readmem;
 	dp->mem_write_sized = stlink_mem_write_sized;
+	dp->mem_poll32 = stlink_mem_poll32;
 }
 
 uint32_t stlink_swdp_scan(bmp_info_s *info)
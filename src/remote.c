@@ -115,6 +115,7 @@ static adiv5_debug_port_s remote_dp = {
 	.ap_write = firmware_ap_write,
 	.mem_read = firmware_mem_read,
 	.mem_write_sized = firmware_mem_write_sized,
+	.mem_poll32 = firmware_mem_poll32,
 };
 
 static void remote_packet_process_swd(unsigned i, char *packet)
@@ -330,12 +331,55 @@ static void remote_packet_process_general(unsigned i, char *packet)
 	}
 }
 
+/*
+ * Expand a REMOTE_AP_MEM_WRITE_LZ payload (see remote.h for the format) into target memory.
+ * The expanded data is only kept for as far back as a back reference can reach, and each
+ * time that window fills it is written out through the AP.
+ */
+static bool remote_mem_write_lz(
+	adiv5_access_port_s *ap, uint32_t dest, const uint8_t *data, size_t data_len, size_t len, align_e align)
+{
+	static uint8_t window[REMOTE_LZ_WINDOW];
+	size_t pos = 0;
+	for (size_t idx = 0; idx < data_len;) {
+		const uint8_t token = data[idx++];
+		size_t run = (token & ~REMOTE_LZ_MATCH) + 1U;
+		size_t distance = 0;
+		if (token & REMOTE_LZ_MATCH) {
+			if (idx == data_len)
+				return false;
+			run += REMOTE_LZ_MIN_MATCH - 1U;
+			distance = data[idx++] + 1U;
+			if (distance > pos)
+				return false;
+		} else if (data_len - idx < run)
+			return false;
+		if (len - pos < run)
+			return false;
+
+		for (size_t offset = 0; offset < run; ++offset, ++pos) {
+			const uint8_t value = distance ? window[(pos - distance) % REMOTE_LZ_WINDOW] : data[idx++];
+			/* About to overwrite the oldest byte, so the whole window is ready to go out */
+			if (pos && pos % REMOTE_LZ_WINDOW == 0)
+				adiv5_mem_write_sized(ap, dest + pos - REMOTE_LZ_WINDOW, window, REMOTE_LZ_WINDOW, align);
+			window[pos % REMOTE_LZ_WINDOW] = value;
+		}
+	}
+	if (pos != len)
+		return false;
+	if (len) {
+		const size_t tail = ((len - 1U) % REMOTE_LZ_WINDOW) + 1U;
+		adiv5_mem_write_sized(ap, dest + len - tail, window, tail, align);
+	}
+	return true;
+}
+
 static void remote_packet_process_high_level(unsigned i, char *packet)
 
 {
-	(void)i;
 	SET_IDLE_STATE(0);
 
+	const char *const packet_start = packet;
 	adiv5_access_port_s remote_ap;
 	/* Re-use packet buffer. Align to DWORD! */
 	void *src = (void *)(((uint32_t)packet + 7U) & ~7U);
@@ -426,6 +470,51 @@ static void remote_packet_process_high_level(unsigned i, char *packet)
 		}
 		remote_respond(REMOTE_RESP_OK, 0);
 		break;
+	case REMOTE_AP_MEM_WRITE_LZ: /* Hz = Write compressed data to memory and set csw */
+		packet += 2;
+		remote_ap.csw = remotehston(8, packet);
+		packet += 8;
+		align = remotehston(2, packet);
+		packet += 2;
+		dest = remotehston(8, packet);
+		packet += 8;
+		len = remotehston(8, packet);
+		packet += 8;
+		if (len & ((1U << align) - 1U)) {
+			/* len  and align do not fit*/
+			remote_respond(REMOTE_RESP_ERR, 0);
+			break;
+		}
+		/* The rest of the packet is the compressed data as a stream of hexified bytes */
+		const size_t data_len = (i - (size_t)(packet - packet_start)) / 2U;
+		unhexify(src, packet, data_len);
+		const bool valid = remote_mem_write_lz(&remote_ap, dest, src, data_len, len, align);
+		if (!valid || remote_ap.dp->fault) {
+			remote_respond(REMOTE_RESP_ERR, 0);
+			remote_ap.dp->fault = 0;
+			break;
+		}
+		remote_respond(REMOTE_RESP_OK, 0);
+		break;
+	case REMOTE_AP_MEM_POLL32: /* HW = Poll a word of memory until it matches */
+		packet += 2;
+		remote_ap.csw = remotehston(8, packet);
+		packet += 8;
+		address = remotehston(8, packet);
+		packet += 8;
+		const uint32_t mask = remotehston(8, packet);
+		packet += 8;
+		value = remotehston(8, packet);
+		packet += 8;
+		const uint32_t timeout = remotehston(8, packet);
+		const bool matched = adiv5_mem_poll32(&remote_ap, address, mask, value, timeout);
+		if (remote_ap.dp->fault) {
+			remote_respond(REMOTE_RESP_ERR, 0);
+			remote_ap.dp->fault = 0;
+			break;
+		}
+		remote_respond(REMOTE_RESP_OK, matched ? 1U : 0U);
+		break;
 	default:
 		remote_respond(REMOTE_RESP_ERR, REMOTE_ERROR_UNRECOGNISED);
 		break;
@@ -448,9 +537,18 @@ void remote_packet_process(unsigned i, char *packet)
 		remote_packet_process_general(i, packet);
 		break;
 
-	case REMOTE_HL_PACKET:
-		remote_packet_process_high_level(i, packet);
+	case REMOTE_HL_PACKET: {
+		/* Hand exceptions, such as link errors, back to the host rather than losing the response to them */
+		volatile exception_s e;
+		TRY_CATCH (e, EXCEPTION_ALL) {
+			remote_packet_process_high_level(i, packet);
+		}
+		if (e.type) {
+			SET_IDLE_STATE(1);
+			remote_respond(REMOTE_RESP_ERR, REMOTE_ERROR_EXCEPTION | ((uint64_t)e.type << 8U));
+		}
 		break;
+	}
 
 	default: /* Oh dear, unrecognised, return an error */
 		remote_respond(REMOTE_RESP_ERR, REMOTE_ERROR_UNRECOGNISED);
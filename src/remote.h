@@ -24,7 +24,9 @@
 #include <inttypes.h>
 #include "general.h"
 
-#define REMOTE_HL_VERSION 2
+#define REMOTE_HL_VERSION 4
+/* Oldest high level protocol version BMDA can make use of */
+#define REMOTE_HL_VERSION_MIN 2
 
 /*
  * Commands to remote end, and responses
@@ -55,6 +57,8 @@
 /* Protocol error messages */
 #define REMOTE_ERROR_UNRECOGNISED 1
 #define REMOTE_ERROR_WRONGLEN     2
+/* An exception was raised running the request, its type follows in the next byte up */
+#define REMOTE_ERROR_EXCEPTION    3
 
 /* Start and end of message identifiers */
 #define REMOTE_SOM  '!'
@@ -101,6 +105,30 @@
 #define REMOTE_MEM_READ           'h'
 #define REMOTE_MEM_WRITE_SIZED    'H'
 #define REMOTE_AP_MEM_WRITE_SIZED 'm'
+#define REMOTE_AP_MEM_WRITE_LZ    'z'
+#define REMOTE_AP_MEM_POLL32      'W'
+
+/*
+ * REMOTE_AP_MEM_WRITE_LZ carries its data compressed as a stream of tokens, the count
+ * in the header being the length of the data once expanded. Each token is either:
+ *  0LLLLLLL <L + 1 literal bytes>       - copy L + 1 (1 to 128) bytes from the stream
+ *  1LLLLLLL DDDDDDDD                    - repeat L + 3 (3 to 130) bytes starting D + 1
+ *                                         (1 to 256) bytes back in the expanded data
+ * Back references never reach before the start of the packet, and may overlap the bytes
+ * they produce, which is how runs of the same byte are encoded.
+ */
+#define REMOTE_LZ_HL_VERSION  3
+#define REMOTE_LZ_MATCH       0x80U
+#define REMOTE_LZ_MAX_LITERAL 128U
+#define REMOTE_LZ_MIN_MATCH   3U
+#define REMOTE_LZ_MAX_MATCH   130U
+#define REMOTE_LZ_WINDOW      256U
+
+/*
+ * REMOTE_AP_MEM_POLL32 re-reads a word on the probe until (word & mask) == value or the
+ * timeout in ms expires, answering K1 on a match, K0 on timeout and E on a bus error.
+ */
+#define REMOTE_POLL_HL_VERSION 4
 
 /* Generic protocol elements */
 #define REMOTE_GEN_PACKET 'G'
@@ -278,6 +306,18 @@
 		REMOTE_SOM, REMOTE_HL_PACKET, REMOTE_AP_MEM_WRITE_SIZED, '%', '0', '2', 'x', '%', '0', '2', 'x', HEX_U32(csw), \
 			'%', '0', '2', 'x', HEX_U32(address), HEX_U32(count), 0                                                    \
 	}
+#define REMOTE_AP_MEM_WRITE_LZ_STR                                                                                  \
+	(char[])                                                                                                        \
+	{                                                                                                               \
+		REMOTE_SOM, REMOTE_HL_PACKET, REMOTE_AP_MEM_WRITE_LZ, '%', '0', '2', 'x', '%', '0', '2', 'x', HEX_U32(csw), \
+			'%', '0', '2', 'x', HEX_U32(address), HEX_U32(count), 0                                                 \
+	}
+#define REMOTE_AP_MEM_POLL32_STR                                                                                  \
+	(char[])                                                                                                      \
+	{                                                                                                             \
+		REMOTE_SOM, REMOTE_HL_PACKET, REMOTE_AP_MEM_POLL32, '%', '0', '2', 'x', '%', '0', '2', 'x', HEX_U32(csw), \
+			HEX_U32(address), HEX_U32(mask), HEX_U32(value), HEX_U32(timeout), REMOTE_EOM, 0                      \
+	}
 #define REMOTE_MEM_WRITE_SIZED_STR                                                                       \
 	(char[])                                                                                             \
 	{                                                                                                    \
@@ -673,6 +673,8 @@ adiv5_access_port_s *adiv5_new_ap(adiv5_debug_port_s *dp, uint8_t apsel)
 	}
 
 	memcpy(ap, &tmpap, sizeof(*ap));
+	if ((ap->idr & ADIV5_AP_IDR_CLASS_MASK) == ADIV5_AP_IDR_CLASS_MEM)
+		dp->mem_aps[apsel / 32U] |= 1U << (apsel % 32U);
 
 #if defined(ENABLE_DEBUG)
 	uint32_t cfg = adiv5_ap_read(ap, ADIV5_AP_CFG);
@@ -810,11 +812,14 @@ void adiv5_dp_init(adiv5_debug_port_s *dp, const uint32_t idcode)
 		dp->mem_read = firmware_mem_read;
 	if (!dp->mem_write_sized)
 		dp->mem_write_sized = firmware_mem_write_sized;
+	if (!dp->mem_poll32)
+		dp->mem_poll32 = firmware_mem_poll32;
 #else
 	dp->ap_write = firmware_ap_write;
 	dp->ap_read = firmware_ap_read;
 	dp->mem_read = firmware_mem_read;
 	dp->mem_write_sized = firmware_mem_write_sized;
+	dp->mem_poll32 = firmware_mem_poll32;
 #endif
 
 	volatile uint32_t ctrlstat = 0;
@@ -1037,6 +1042,31 @@ void firmware_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t
 	adiv5_unpack_data(dest, src, value, align);
 }
 
+/*
+ * Re-read a word until (value & mask) == expected or timeout (in ms) expires. TAR is written once
+ * with auto-increment off so each poll costs a single posted DRW read; as every read is of the
+ * same location, the one-behind data posting returns is still a real sample of it.
+ */
+bool firmware_mem_poll32(
+	adiv5_access_port_s *ap, const uint32_t addr, const uint32_t mask, const uint32_t value, const uint32_t timeout)
+{
+	platform_timeout_s poll_timeout;
+	platform_timeout_set(&poll_timeout, timeout);
+	adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_ADDRINC_NONE | ADIV5_AP_CSW_SIZE_WORD);
+	adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR, addr);
+	adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_AP_DRW, 0);
+	bool matched = false;
+	while (!ap->dp->fault) {
+		const uint32_t result = adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_AP_DRW, 0);
+		matched = (result & mask) == value;
+		if (matched || platform_timeout_is_expired(&poll_timeout))
+			break;
+	}
+	/* Drain the read still in flight */
+	adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_DP_RDBUFF, 0);
+	return matched && !ap->dp->fault;
+}
+
 void firmware_mem_write_sized(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align)
 {
 	uint32_t odest = dest;
@@ -1088,6 +1118,176 @@ uint32_t firmware_ap_read(adiv5_access_port_s *ap, uint16_t addr)
 	return ret;
 }
 
+/*
+ * Every DP backend ends up here when a transfer comes back corrupted (an invalid ACK or bad parity),
+ * so an automatically tuned SWJ clock gets stepped down whichever probe is in use before the access
+ * is abandoned.
+ */
+void adiv5_dp_link_error(const char *reason)
+{
+	target_swj_frequency_backoff();
+	raise_exception(EXCEPTION_ERROR, reason);
+}
+
+#if PC_HOSTED == 1
+/*
+ * Batched block transfers, for backends that can queue a whole run of SWD transactions and fetch all
+ * the ACKs and data back in one go.
+ *
+ * The backend's run_batch does a TAR write, `count` DRW accesses and a RDBUFF read, with read data for
+ * unit n stored to values[n], and returns how many of those transfers got an OK ACK. *ack is set to the
+ * first failure. Overrun detection (CTRL/STAT.ORUNDETECT) is on for the duration of the block, so the
+ * data phase is always clocked. A WAIT or FAULT latches STICKYORUN and every later transfer in the
+ * batch FAULTs without side effects, so the block is picked up again from the first unit that did not
+ * complete. batch_units says how many DRW accesses fit in one batch.
+ */
+
+#define ADIV5_BATCH_WAIT_TIMEOUT 2000U
+
+static uint32_t adiv5_batch_values[ADIV5_BATCH_MAX_UNITS];
+
+/* How many units the next batch may move without crossing a TAR auto-increment boundary */
+static size_t adiv5_batch_len(
+	adiv5_debug_port_s *const dp, const uint32_t addr, const align_e align, const size_t remaining, const bool write)
+{
+	const size_t page_units = (0x400U - (addr & 0x3ffU)) >> align;
+	return MIN(MIN(remaining, dp->batch_units(write)), MIN(page_units, ADIV5_BATCH_MAX_UNITS));
+}
+
+/* Run one batch, returning how many units completed */
+static size_t adiv5_batch_run(
+	adiv5_debug_port_s *const dp, const uint32_t addr, const size_t count, const bool write, uint8_t *const ack)
+{
+	*ack = SWDP_ACK_OK;
+	const size_t transfers = count + 2U;
+	const size_t transfer = MIN(dp->run_batch(addr, adiv5_batch_values, count, write, ack), transfers);
+	/* For reads, unit n's data arrives with transfer n + 2 */
+	if (!write)
+		return transfer >= 2U ? transfer - 2U : 0U;
+	/*
+	 * For writes, unit n is transfer n + 1. Writes are posted, so a write that faults on the bus
+	 * shows up as a FAULT on the transfer after it, which means the write before a failed transfer
+	 * isn't done unless the failure was a WAIT for it to finish.
+	 */
+	const size_t settled = transfer == transfers || *ack == SWDP_ACK_WAIT ? transfer : transfer ? transfer - 1U : 0U;
+	return settled ? MIN(settled - 1U, count) : 0U;
+}
+
+static void adiv5_batch_overrun_detect(adiv5_debug_port_s *const dp, const bool enable)
+{
+	adiv5_dp_write(dp, ADIV5_DP_CTRLSTAT,
+		ADIV5_DP_CTRLSTAT_CSYSPWRUPREQ | ADIV5_DP_CTRLSTAT_CDBGPWRUPREQ |
+			(enable ? ADIV5_DP_CTRLSTAT_ORUNDETECT : 0U));
+}
+
+/*
+ * Deal with whatever stopped a batch and leave overrun detection mode. Returns true if the batch
+ * can be picked up again, which is only the case after a WAIT. A bus fault is left latched in
+ * CTRL/STAT with dp->fault set, so target_check_error() reports it the same as on the per-transfer
+ * path. Anything else is cleared for the per-transfer path to retry.
+ */
+static bool adiv5_batch_recover(adiv5_debug_port_s *const dp, const uint8_t ack)
+{
+	DEBUG_PROBE("Batch stopped with ACK %u, recovering\n", ack);
+	if (ack == SWDP_ACK_WAIT || ack == SWDP_ACK_FAULT) {
+		const uint32_t ctrlstat = adiv5_dp_read(dp, ADIV5_DP_CTRLSTAT);
+		if (ctrlstat & ADIV5_DP_CTRLSTAT_STICKYERR) {
+			adiv5_dp_abort(dp, ADIV5_DP_ABORT_ORUNERRCLR);
+			adiv5_batch_overrun_detect(dp, false);
+			dp->fault = SWDP_ACK_FAULT;
+			return false;
+		}
+		/* A write data parity error means the link corrupted what we sent */
+		if (ctrlstat & ADIV5_DP_CTRLSTAT_WDATAERR)
+			target_swj_frequency_backoff();
+		dp->error(dp, false);
+	} else {
+		target_swj_frequency_backoff();
+		dp->error(dp, true);
+	}
+	adiv5_batch_overrun_detect(dp, false);
+	return ack == SWDP_ACK_WAIT;
+}
+
+void adiv5_batch_mem_read(adiv5_access_port_s *const ap, void *dest, uint32_t src, const size_t len)
+{
+	adiv5_debug_port_s *const dp = ap->dp;
+	if (!len || dp->fault) {
+		firmware_mem_read(ap, dest, src, len);
+		return;
+	}
+	const align_e align = MIN(ALIGNOF(src), ALIGNOF(len));
+	size_t remaining = len >> align;
+	ap_mem_access_setup(ap, src, align);
+	adiv5_batch_overrun_detect(dp, true);
+
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, ADIV5_BATCH_WAIT_TIMEOUT);
+	while (remaining) {
+		uint8_t ack = SWDP_ACK_OK;
+		const size_t done = adiv5_batch_run(dp, src, adiv5_batch_len(dp, src, align, remaining, false), false, &ack);
+		for (size_t i = 0; i < done; ++i) {
+			dest = adiv5_unpack_data(dest, src, adiv5_batch_values[i], align);
+			src += 1U << align;
+		}
+		remaining -= done;
+		if (ack == SWDP_ACK_OK)
+			continue;
+		const bool resume = adiv5_batch_recover(dp, ack);
+		if (dp->fault)
+			return;
+		if (!resume || platform_timeout_is_expired(&timeout)) {
+			/* Let the per-transfer path retry the rest and report whatever went wrong */
+			firmware_mem_read(ap, dest, src, remaining << align);
+			return;
+		}
+		adiv5_batch_overrun_detect(dp, true);
+	}
+	adiv5_batch_overrun_detect(dp, false);
+}
+
+void adiv5_batch_mem_write_sized(
+	adiv5_access_port_s *const ap, uint32_t dest, const void *src, const size_t len, const align_e align)
+{
+	adiv5_debug_port_s *const dp = ap->dp;
+	if (!len || dp->fault) {
+		firmware_mem_write_sized(ap, dest, src, len, align);
+		return;
+	}
+	size_t remaining = len >> align;
+	ap_mem_access_setup(ap, dest, align);
+	adiv5_batch_overrun_detect(dp, true);
+
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, ADIV5_BATCH_WAIT_TIMEOUT);
+	while (remaining) {
+		const size_t count = adiv5_batch_len(dp, dest, align, remaining, true);
+		const void *batch_src = src;
+		uint32_t batch_dest = dest;
+		for (size_t i = 0; i < count; ++i) {
+			batch_src = adiv5_pack_data(batch_dest, batch_src, &adiv5_batch_values[i], align);
+			batch_dest += 1U << align;
+		}
+		uint8_t ack = SWDP_ACK_OK;
+		const size_t done = adiv5_batch_run(dp, dest, count, true, &ack);
+		src = (const uint8_t *)src + (done << align);
+		dest += done << align;
+		remaining -= done;
+		if (ack == SWDP_ACK_OK)
+			continue;
+		const bool resume = adiv5_batch_recover(dp, ack);
+		if (dp->fault)
+			return;
+		if (!resume || platform_timeout_is_expired(&timeout)) {
+			firmware_mem_write_sized(ap, dest, src, remaining << align, align);
+			return;
+		}
+		adiv5_batch_overrun_detect(dp, true);
+	}
+	adiv5_batch_overrun_detect(dp, false);
+}
+#endif
+
 void adiv5_mem_write(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len)
 {
 	align_e align = MIN(ALIGNOF(dest), ALIGNOF(len));
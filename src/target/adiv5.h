@@ -61,6 +61,8 @@
 #define ADIV5_DP_BANK2 2U
 #define ADIV5_DP_BANK3 3U
 #define ADIV5_DP_BANK4 4U
+/* DP SELECT register AP bank select field */
+#define ADIV5_DP_SELECT_APBANKSEL_MASK 0xf0U
 
 /* DP TARGETID */
 #define ADIV5_DP_TARGETID_TREVISION_OFFSET 28U
@@ -129,6 +131,11 @@
 #define ADIV5_AP_BASE ADIV5_AP_REG(0xf8U)
 #define ADIV5_AP_IDR  ADIV5_AP_REG(0xfcU)
 
+/* AP Identification Register (IDR) */
+#define ADIV5_AP_IDR_CLASS_SHIFT 13U
+#define ADIV5_AP_IDR_CLASS_MASK  (0xfU << ADIV5_AP_IDR_CLASS_SHIFT)
+#define ADIV5_AP_IDR_CLASS_MEM   (0x8U << ADIV5_AP_IDR_CLASS_SHIFT)
+
 /* AP Control and Status Word (CSW) */
 #define ADIV5_AP_CSW_DBGSWENABLE (1U << 31U)
 /* Bits 30:24 - Prot, Implementation defined, for Cortex-M3: */
@@ -266,12 +273,18 @@ struct adiv5_debug_port {
 	void (*ap_reg_write)(adiv5_access_port_s *ap, int num, uint32_t value);
 	void (*read_block)(uint32_t addr, uint8_t *data, int size);
 	void (*dap_write_block_sized)(uint32_t addr, uint8_t *data, int size, align_e align);
+	/* Batched DRW transfers for adiv5_batch_mem_read() and adiv5_batch_mem_write_sized() */
+	size_t (*batch_units)(bool write);
+	size_t (*run_batch)(uint32_t addr, uint32_t *values, size_t count, bool write, uint8_t *ack);
+	/* Set when mem_poll32 waits inside the adaptor rather than looping over the link from here */
+	bool mem_poll32_on_probe;
 #endif
 	uint32_t (*ap_read)(adiv5_access_port_s *ap, uint16_t addr);
 	void (*ap_write)(adiv5_access_port_s *ap, uint16_t addr, uint32_t value);
 
 	void (*mem_read)(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len);
 	void (*mem_write_sized)(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align);
+	bool (*mem_poll32)(adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout);
 	uint8_t dp_jd_index;
 	uint8_t fault;
 
@@ -283,6 +296,9 @@ struct adiv5_debug_port {
 
 	bool mindp;
 
+	/* APs found to be MEM-APs, one bit per APSEL, so their side-effect free registers can be relied on */
+	uint32_t mem_aps[8];
+
 	/* DP designer (not implementer!) and partno */
 	uint16_t designer_code;
 	uint16_t partno;
@@ -353,6 +369,12 @@ static inline void adiv5_mem_write_sized(
 	return ap->dp->mem_write_sized(ap, dest, src, len, align);
 }
 
+static inline bool adiv5_mem_poll32(
+	adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout)
+{
+	return ap->dp->mem_poll32(ap, addr, mask, value, timeout);
+}
+
 static inline void adiv5_dp_write(adiv5_debug_port_s *dp, uint16_t addr, uint32_t value)
 {
 	dp->low_access(dp, ADIV5_LOW_WRITE, addr, value);
@@ -367,6 +389,7 @@ uint32_t adiv5_ap_read(adiv5_access_port_s *ap, uint16_t addr);
 void adiv5_ap_write(adiv5_access_port_s *ap, uint16_t addr, uint32_t value);
 void adiv5_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len);
 void adiv5_mem_write_sized(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align);
+bool adiv5_mem_poll32(adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout);
 void adiv5_dp_write(adiv5_debug_port_s *dp, uint16_t addr, uint32_t value);
 #endif
 
@@ -405,6 +428,7 @@ const void *adiv5_pack_data(uint32_t dest, const void *src, uint32_t *data, alig
 void ap_mem_access_setup(adiv5_access_port_s *ap, uint32_t addr, align_e align);
 void firmware_mem_write_sized(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align);
 void firmware_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len);
+bool firmware_mem_poll32(adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout);
 void firmware_ap_write(adiv5_access_port_s *ap, uint16_t addr, uint32_t value);
 uint32_t firmware_ap_read(adiv5_access_port_s *ap, uint16_t addr);
 uint32_t firmware_swdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_t addr, uint32_t value);
@@ -413,6 +437,17 @@ uint32_t firmware_swdp_read(adiv5_debug_port_s *dp, uint16_t addr);
 uint32_t fw_adiv5_jtagdp_read(adiv5_debug_port_s *dp, uint16_t addr);
 
 uint32_t firmware_swdp_error(adiv5_debug_port_s *dp, bool protocol_recovery);
+void adiv5_dp_link_error(const char *reason);
+
+#if PC_HOSTED == 1
+/* Most DRW accesses a batch can carry, as many byte accesses as fit in one TAR auto-increment page */
+#define ADIV5_BATCH_MAX_UNITS    1024U
+/* What run_batch sets *ack to for a read that had a good ACK but bad data parity */
+#define ADIV5_BATCH_PARITY_ERROR 0U
+
+void adiv5_batch_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len);
+void adiv5_batch_mem_write_sized(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align);
+#endif
 
 void firmware_swdp_abort(adiv5_debug_port_s *dp, uint32_t abort);
 void adiv5_jtagdp_abort(adiv5_debug_port_s *dp, uint32_t abort);
@@ -39,6 +39,13 @@
 
 static uint32_t adiv5_jtagdp_error(adiv5_debug_port_s *dp, bool protocol_recovery);
 
+/* Whether SELECT picks bank 0 of an AP that's been identified as a MEM-AP */
+static bool adiv5_jtagdp_mem_ap_bank0(const adiv5_debug_port_s *const dp, const uint32_t select)
+{
+	const uint8_t apsel = select >> 24U;
+	return !(select & ADIV5_DP_SELECT_APBANKSEL_MASK) && (dp->mem_aps[apsel / 32U] & (1U << (apsel % 32U)));
+}
+
 void adiv5_jtag_dp_handler(uint8_t jd_index)
 {
 	adiv5_debug_port_s *dp = calloc(1, sizeof(*dp));
@@ -68,6 +75,8 @@ uint32_t fw_adiv5_jtagdp_read(adiv5_debug_port_s *dp, uint16_t addr)
 static uint32_t adiv5_jtagdp_error(adiv5_debug_port_s *dp, const bool protocol_recovery)
 {
 	(void)protocol_recovery;
+	/* Don't trust our copy of SELECT across error recovery */
+	jtag_devs[dp->dp_jd_index].dp_select_valid = false;
 	const uint32_t status = fw_adiv5_jtagdp_read(dp, ADIV5_DP_CTRLSTAT) & ADIV5_DP_CTRLSTAT_ERRMASK;
 	dp->fault = 0;
 	return fw_adiv5_jtagdp_low_access(dp, ADIV5_LOW_WRITE, ADIV5_DP_CTRLSTAT, status) & 0x32U;
@@ -75,9 +84,28 @@ static uint32_t adiv5_jtagdp_error(adiv5_debug_port_s *dp, const bool protocol_r
 
 uint32_t fw_adiv5_jtagdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_t addr, uint32_t value)
 {
-	const bool APnDP = addr & ADIV5_APnDP;
+	jtag_dev_s *const device = &jtag_devs[dp->dp_jd_index];
+	bool APnDP = addr & ADIV5_APnDP;
 	addr &= 0xffU;
 
+	if (!APnDP && !RnW && addr == ADIV5_DP_SELECT) {
+		/* Every AP access writes SELECT first, skip it (and the IR switch to DPACC) if it already holds this */
+		if (device->dp_select_valid && device->dp_select == value)
+			return 0;
+		device->dp_select = value;
+		device->dp_select_valid = true;
+	} else if (!APnDP && RnW && addr == ADIV5_DP_RDBUFF && device->current_ir == IR_APACC &&
+		device->dp_select_valid && adiv5_jtagdp_mem_ap_bank0(dp, device->dp_select)) {
+		/*
+		 * The result of an AP read comes back in the next scan, whatever that is. If the IR still
+		 * holds APACC and SELECT points at bank 0 of a MEM-AP, collect it with a side-effect free
+		 * read of CSW rather than switching the IR over to DPACC just to read RDBUFF and back again.
+		 * Other APs may well have side effects on reads of register 0, so they always use RDBUFF.
+		 */
+		APnDP = true;
+		addr = ADIV5_AP_CSW & 0xffU;
+	}
+
 	const uint64_t request = ((uint64_t)value << 3U) | ((addr >> 1U) & 0x06U) | (RnW ? 1U : 0U);
 
 	uint32_t result;
@@ -87,23 +115,33 @@ uint32_t fw_adiv5_jtagdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_
 
 	platform_timeout_s timeout;
 	platform_timeout_set(&timeout, 250);
-	do {
+	while (true) {
 		uint64_t response;
 		jtag_dev_shift_dr(dp->dp_jd_index, (uint8_t *)&response, (uint8_t *)&request, 35);
 		result = response >> 3U;
 		ack = response & 0x07U;
-	} while (!platform_timeout_is_expired(&timeout) && ack == JTAGDP_ACK_WAIT);
+		if (ack != JTAGDP_ACK_WAIT || platform_timeout_is_expired(&timeout))
+			break;
+		/*
+		 * The access was ignored as the previous one is still in progress, so give the AP some
+		 * Run-Test/Idle cycles to finish it in, even when scans otherwise skip the idle state,
+		 * and then reissue it.
+		 */
+		jtagtap_idle(jtag_proc.tap_idle_cycles + 1U);
+	}
 
 	if (ack == JTAGDP_ACK_WAIT) {
 		DEBUG_WARN("JTAG access resulted in wait, aborting\n");
+		device->dp_select_valid = false;
 		dp->abort(dp, ADIV5_DP_ABORT_DAPABORT);
 		dp->fault = 1;
 		return 0;
 	}
 
 	if (ack != JTAGDP_ACK_OK) {
+		device->dp_select_valid = false;
 		DEBUG_WARN("JTAG access resulted in: %" PRIx32 ":%x\n", result, ack);
-		raise_exception(EXCEPTION_ERROR, "JTAG-DP invalid ACK");
+		adiv5_dp_link_error("JTAG-DP invalid ACK");
 	}
 
 	return result;
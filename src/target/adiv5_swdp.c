@@ -290,14 +290,14 @@ uint32_t firmware_swdp_low_access(adiv5_debug_port_s *dp, const uint8_t RnW, con
 
 	if (ack != SWDP_ACK_OK) {
 		DEBUG_WARN("SWD access has invalid ack %x\n", ack);
-		raise_exception(EXCEPTION_ERROR, "SWD invalid ACK");
+		adiv5_dp_link_error("SWD invalid ACK");
 	}
 
 	if (RnW) {
 		if (dp->seq_in_parity(&response, 32)) { /* Give up on parity error */
 			dp->fault = 1;
 			DEBUG_WARN("SWD access resulted in parity error\n");
-			raise_exception(EXCEPTION_ERROR, "SWD parity error");
+			adiv5_dp_link_error("SWD parity error");
 		}
 	} else {
 		dp->seq_out_parity(value, 32);
@@ -34,6 +34,7 @@
 #include "target_internal.h"
 #include "target_probe.h"
 #include "cortexm.h"
+#include "flm.h"
 #include "gdb_reg.h"
 #include "command.h"
 #include "gdb_packet.h"
@@ -74,9 +75,20 @@ static bool cortexm_vector_catch(target_s *t, int argc, const char **argv);
 #if PC_HOSTED == 0
 static bool cortexm_redirect_stdout(target_s *t, int argc, const char **argv);
 #endif
+static bool cortexm_profile(target_s *t, int argc, const char **argv);
 
 const command_s cortexm_cmd_list[] = {
 	{"vector_catch", cortexm_vector_catch, "Catch exception vectors"},
+#if PC_HOSTED == 1
+	{"load_flm", flm_cmd_load, "Drive Flash with a CMSIS-Pack algorithm: file [ram_start ram_length]"},
+#else
+	{"load_flm", flm_cmd_load, "Drive Flash with an uploaded CMSIS-Pack algorithm: addr len [ram_start ram_len]"},
+#endif
+#if PC_HOSTED == 1
+	{"profile", cortexm_profile, "Sample the running PC via DWT: [ms [folded|gmon [file]]]"},
+#else
+	{"profile", cortexm_profile, "Sample the running PC via DWT: [ms]"},
+#endif
 #if PC_HOSTED == 0
 	{"redirect_stdout", cortexm_redirect_stdout, "Redirect semihosting stdout to USB UART"},
 #endif
@@ -94,8 +106,8 @@ static uint32_t cortexm_pc_read(target_s *t);
 static ssize_t cortexm_reg_read(target_s *t, int reg, void *data, size_t max);
 static ssize_t cortexm_reg_write(target_s *t, int reg, const void *data, size_t max);
 
-static void cortexm_reset(target_s *t);
 static target_halt_reason_e cortexm_halt_poll(target_s *t, target_addr_t *watch);
+static bool cortexm_halt_wait(target_s *t, uint32_t timeout);
 static void cortexm_halt_request(target_s *t);
 static int cortexm_fault_unwind(target_s *t);
 
@@ -107,9 +119,18 @@ static target_addr_t cortexm_check_watch(target_s *t);
 #define CORTEXM_MAX_BREAKPOINTS 8U /* architecture says up to 127, no implementation has > 8 */
 
 static int cortexm_hostio_request(target_s *t);
+static bool cortexm_hostio_console(target_s *t);
+static bool cortexm_link_test(target_s *t);
 
 static uint32_t time0_sec = UINT32_MAX; /* sys_clock time origin */
 
+/* What we know about the D-cache contents, only tracked while the core is halted */
+typedef enum cortexm_dcache_state {
+	CORTEXM_DCACHE_UNKNOWN, /* The core may have run since the last full clean */
+	CORTEXM_DCACHE_CLEAN,   /* No dirty lines, the debugger sees up to date RAM */
+	CORTEXM_DCACHE_EMPTY,   /* Nothing cached, debugger writes can't go stale either */
+} cortexm_dcache_state_e;
+
 typedef struct cortexm_priv {
 	adiv5_access_port_s *ap;
 	bool stepping;
@@ -126,6 +147,17 @@ typedef struct cortexm_priv {
 	/* Cache parameters */
 	bool has_cache;
 	uint32_t dcache_minline;
+	uint32_t dcache_sets;
+	uint32_t dcache_ways;
+	uint8_t dcache_set_shift;
+	uint8_t dcache_way_shift;
+	/* D-cache maintenance tracking, reset whenever the core may run */
+	bool halted;
+	cortexm_dcache_state_e dcache_state;
+	uint32_t dcache_lines_maintained;
+	/* Register file saved around calls into target code, see cortexm_call_begin() */
+	uint32_t *call_context;
+	uint8_t call_depth;
 } cortexm_priv_s;
 
 /* Register number tables */
@@ -445,13 +477,37 @@ adiv5_access_port_s *cortexm_ap(target_s *t)
 	return ((cortexm_priv_s *)t->priv)->ap;
 }
 
-static void cortexm_cache_clean(target_s *t, target_addr_t addr, size_t len, bool invalidate)
+/*
+ * Cache maintenance is a long run of writes to a single SCS register. On the firmware we set the
+ * AP up once with address increment off and then only have to stream the DRW writes.
+ */
+static void cortexm_cache_op_start(adiv5_access_port_s *ap, uint32_t reg)
+{
+#if PC_HOSTED == 0
+	adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_ADDRINC_NONE | ADIV5_AP_CSW_SIZE_WORD);
+	adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR, reg);
+#else
+	(void)ap;
+	(void)reg;
+#endif
+}
+
+static inline void cortexm_cache_op(adiv5_access_port_s *ap, uint32_t reg, uint32_t value)
+{
+#if PC_HOSTED == 0
+	(void)reg;
+	adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DRW, value);
+#else
+	adiv5_mem_write(ap, reg, &value, sizeof(value));
+#endif
+}
+
+/* Walk the cache lines of [addr, addr + len) that fall in RAM, optionally performing cache_reg on each */
+static size_t cortexm_cache_lines(target_s *t, target_addr_t addr, size_t len, uint32_t cache_reg)
 {
 	cortexm_priv_s *priv = t->priv;
-	if (!priv->has_cache || (priv->dcache_minline == 0))
-		return;
-	uint32_t cache_reg = invalidate ? CORTEXM_DCCIMVAC : CORTEXM_DCCMVAC;
-	size_t minline = priv->dcache_minline;
+	const size_t minline = priv->dcache_minline;
+	size_t lines = 0;
 
 	/* flush data cache for RAM regions that intersect requested region */
 	target_addr_t mem_end = addr + len; /* following code is NOP if wraparound */
@@ -465,9 +521,60 @@ static void cortexm_cache_clean(target_s *t, target_addr_t addr, size_t len, boo
 		if (mem_end < ram_end)
 			ram_end = mem_end;
 		/* intersection is [ram, ram_end) */
-		for (ram &= ~(minline - 1U); ram < ram_end; ram += minline)
-			adiv5_mem_write(cortexm_ap(t), cache_reg, &ram, 4);
+		for (ram &= ~(minline - 1U); ram < ram_end; ram += minline) {
+			if (cache_reg)
+				cortexm_cache_op(priv->ap, cache_reg, ram);
+			++lines;
+		}
+	}
+	return lines;
+}
+
+static void cortexm_cache_clean(target_s *t, target_addr_t addr, size_t len, bool invalidate)
+{
+	cortexm_priv_s *priv = t->priv;
+	if (!priv->has_cache || (priv->dcache_minline == 0))
+		return;
+	/*
+	 * The core can't dirty (or allocate) cache lines while halted, so once we've cleaned the whole
+	 * cache reads need no further maintenance, and once it's been emptied neither do writes.
+	 */
+	if (priv->dcache_state == CORTEXM_DCACHE_EMPTY || (priv->dcache_state == CORTEXM_DCACHE_CLEAN && !invalidate))
+		return;
+
+	const size_t lines = cortexm_cache_lines(t, addr, len, 0U);
+	if (!lines)
+		return;
+	const uint32_t cache_lines = priv->dcache_sets * priv->dcache_ways;
+	/*
+	 * Once doing the request line by line would cost more than a whole-cache operation by set/way
+	 * (including what we've already done by line since the halt), do that instead.
+	 */
+	if (lines > cache_lines || (priv->halted && priv->dcache_lines_maintained + lines > cache_lines)) {
+		const uint32_t cache_reg = invalidate ? CORTEXM_DCCISW : CORTEXM_DCCSW;
+		cortexm_cache_op_start(priv->ap, cache_reg);
+		for (uint32_t way = 0; way < priv->dcache_ways; ++way) {
+			for (uint32_t set = 0; set < priv->dcache_sets; ++set)
+				cortexm_cache_op(
+					priv->ap, cache_reg, (way << priv->dcache_way_shift) | (set << priv->dcache_set_shift));
+		}
+		if (priv->halted)
+			priv->dcache_state = invalidate ? CORTEXM_DCACHE_EMPTY : CORTEXM_DCACHE_CLEAN;
+		return;
 	}
+
+	const uint32_t cache_reg = invalidate ? CORTEXM_DCCIMVAC : CORTEXM_DCCMVAC;
+	cortexm_cache_op_start(priv->ap, cache_reg);
+	cortexm_cache_lines(t, addr, len, cache_reg);
+	priv->dcache_lines_maintained += lines;
+}
+
+/* Forget what we know about the D-cache, the core is about to run (or has run) */
+static void cortexm_cache_forget(cortexm_priv_s *priv)
+{
+	priv->halted = false;
+	priv->dcache_state = CORTEXM_DCACHE_UNKNOWN;
+	priv->dcache_lines_maintained = 0;
 }
 
 static void cortexm_mem_read(target_s *t, void *dest, target_addr_t src, size_t len)
@@ -482,15 +589,52 @@ static void cortexm_mem_write(target_s *t, target_addr_t dest, const void *src,
 	adiv5_mem_write(cortexm_ap(t), dest, src, len);
 }
 
+static bool cortexm_mem_poll32(
+	target_s *t, const uint32_t addr, const uint32_t mask, const uint32_t value, const uint32_t timeout)
+{
+	cortexm_cache_clean(t, addr, sizeof(uint32_t), false);
+	return adiv5_mem_poll32(cortexm_ap(t), addr, mask, value, timeout);
+}
+
 static bool cortexm_check_error(target_s *t)
 {
 	adiv5_access_port_s *ap = cortexm_ap(t);
-	return adiv5_dp_error(ap->dp) != 0;
+	const uint32_t err = adiv5_dp_error(ap->dp);
+	/*
+	 * A faulting access stops the MEM-AP with TAR still holding its address, and nothing after it
+	 * goes through until the flags are cleared, so TAR still tells us what failed.
+	 */
+	if (err & ADIV5_DP_CTRLSTAT_STICKYERR)
+		t->fault_addr = adiv5_ap_read(ap, ADIV5_AP_TAR);
+	return err != 0;
+}
+
+/* Number of DEMCR read/write-back/read rounds the link has to get through to pass */
+#define CORTEXM_LINK_TEST_ROUNDS 32U
+
+static bool cortexm_link_test(target_s *t)
+{
+	adiv5_access_port_s *ap = cortexm_ap(t);
+	volatile bool passed = true;
+	volatile exception_s e;
+	TRY_CATCH (e, EXCEPTION_ALL) {
+		/* Start from a clean DP, a previous run may have left it in a protocol error */
+		ap->dp->fault = 0;
+		ap->dp->error(ap->dp, true);
+		for (size_t round = 0; round < CORTEXM_LINK_TEST_ROUNDS && passed; ++round) {
+			const uint32_t demcr = target_mem_read32(t, CORTEXM_DEMCR);
+			target_mem_write32(t, CORTEXM_DEMCR, demcr);
+			if (target_mem_read32(t, CORTEXM_DEMCR) != demcr || target_check_error(t))
+				passed = false;
+		}
+	}
+	return passed && !e.type;
 }
 
 static void cortexm_priv_free(void *priv)
 {
 	adiv5_ap_unref(((cortexm_priv_s *)priv)->ap);
+	free(((cortexm_priv_s *)priv)->call_context);
 	free(priv);
 }
 
@@ -584,6 +728,8 @@ bool cortexm_probe(adiv5_access_port_s *ap)
 	t->check_error = cortexm_check_error;
 	t->mem_read = cortexm_mem_read;
 	t->mem_write = cortexm_mem_write;
+	t->mem_poll32 = cortexm_mem_poll32;
+	t->link_test = cortexm_link_test;
 
 	t->driver = cortexm_driver_str;
 
@@ -610,6 +756,7 @@ bool cortexm_probe(adiv5_access_port_s *ap)
 	t->halt_request = cortexm_halt_request;
 	t->halt_poll = cortexm_halt_poll;
 	t->halt_resume = cortexm_halt_resume;
+	t->halt_wait = cortexm_halt_wait;
 	t->regs_size = sizeof(regnum_cortex_m);
 
 	t->breakwatch_set = cortexm_breakwatch_set;
@@ -630,6 +777,14 @@ bool cortexm_probe(adiv5_access_port_s *ap)
 	if (ctr >> 29U == 4U) {
 		priv->has_cache = true;
 		priv->dcache_minline = 4U << (ctr & 0xfU);
+		/* Read out the L1 D-cache geometry for set/way operations */
+		target_mem_write32(t, CORTEXM_CSSELR, 0U);
+		const uint32_t ccsidr = target_mem_read32(t, CORTEXM_CCSIDR);
+		priv->dcache_sets = CORTEXM_CCSIDR_NUMSETS(ccsidr) + 1U;
+		priv->dcache_ways = CORTEXM_CCSIDR_ASSOCIATIVITY(ccsidr) + 1U;
+		/* Sets are indexed from the log2 of the line length, ways are packed into the top bits */
+		priv->dcache_set_shift = CORTEXM_CCSIDR_LINESIZE(ccsidr) + 4U;
+		priv->dcache_way_shift = priv->dcache_ways > 1U ? __builtin_clz(priv->dcache_ways - 1U) : 0U;
 	} else
 		target_check_error(t);
 
@@ -764,6 +919,7 @@ bool cortexm_attach(target_s *t)
 	adiv5_access_port_s *ap = cortexm_ap(t);
 	ap->dp->fault = 1; /* Force switch to this multi-drop device*/
 	cortexm_priv_s *priv = t->priv;
+	cortexm_cache_forget(priv);
 
 	/* Clear any pending fault condition */
 	target_check_error(t);
@@ -838,6 +994,7 @@ void cortexm_detach(target_s *t)
 	target_mem_write32(t, CORTEXM_DEMCR, ap->ap_cortexm_demcr);
 	/* Disable debug */
 	target_mem_write32(t, CORTEXM_DHCSR, CORTEXM_DHCSR_DBGKEY);
+	cortexm_cache_forget(priv);
 }
 
 enum {
@@ -980,8 +1137,9 @@ static void cortexm_pc_write(target_s *t, const uint32_t val)
 
 /* The following three routines implement target halt/resume
  * using the core debug registers in the NVIC. */
-static void cortexm_reset(target_s *t)
+void cortexm_reset(target_s *t)
 {
+	cortexm_cache_forget(t->priv);
 	/* Read DHCSR here to clear S_RESET_ST bit before reset */
 	target_mem_read32(t, CORTEXM_DHCSR);
 	platform_timeout_s reset_timeout;
@@ -1054,6 +1212,7 @@ static target_halt_reason_e cortexm_halt_poll(target_s *t, target_addr_t *watch)
 
 	if (!(dhcsr & CORTEXM_DHCSR_S_HALT))
 		return TARGET_HALT_RUNNING;
+	priv->halted = true;
 
 	/* We've halted.  Let's find out why. */
 	uint32_t dfsr = target_mem_read32(t, CORTEXM_DFSR);
@@ -1071,10 +1230,12 @@ static target_halt_reason_e cortexm_halt_poll(target_s *t, target_addr_t *watch)
 		uint16_t bkpt_instr;
 		bkpt_instr = target_mem_read16(t, pc);
 		if (bkpt_instr == 0xbeabU) {
-			if (cortexm_hostio_request(t))
+			/* Console output is dealt with right here, anything else goes through the full hostio path */
+			if (!cortexm_hostio_console(t) && cortexm_hostio_request(t))
 				return TARGET_HALT_REQUEST;
 
-			target_halt_resume(t, priv->stepping);
+			/* Resume through the hook directly so any range step in progress carries on */
+			t->halt_resume(t, priv->stepping);
 			return TARGET_HALT_RUNNING;
 		}
 	}
@@ -1087,12 +1248,46 @@ static target_halt_reason_e cortexm_halt_poll(target_s *t, target_addr_t *watch)
 	if (dfsr & CORTEXM_DFSR_BKPT)
 		return TARGET_HALT_BREAKPOINT;
 
-	if (dfsr & CORTEXM_DFSR_HALTED)
-		return priv->stepping ? TARGET_HALT_STEPPING : TARGET_HALT_REQUEST;
+	if (dfsr & CORTEXM_DFSR_HALTED) {
+		/* A step that was interrupted by a halt request (Ctrl-C) is reported as the request */
+		if (!priv->stepping || t->halt_requested)
+			return TARGET_HALT_REQUEST;
+		/* Range stepping: step again without reporting while the PC is still inside the range */
+		if (t->step_range_end) {
+			const uint32_t pc = cortexm_pc_read(t);
+			if (pc >= t->step_range_start && pc < t->step_range_end) {
+				t->halt_resume(t, true);
+				return TARGET_HALT_RUNNING;
+			}
+		}
+		return TARGET_HALT_STEPPING;
+	}
 
 	return TARGET_HALT_BREAKPOINT;
 }
 
+/*
+ * Wait for S_HALT using the probe-side memory poll, so on BMDA the wait happens in the adaptor
+ * (CMSIS-DAP match read, BMP remote poll) rather than as a round trip per DHCSR read. Returns false
+ * without waiting when the adaptor can't do that, as the poll would then just hammer the link.
+ */
+static bool cortexm_halt_wait(target_s *t, const uint32_t timeout)
+{
+#if PC_HOSTED == 1
+	if (!cortexm_ap(t)->dp->mem_poll32_on_probe)
+		return false;
+#endif
+	volatile exception_s e;
+	TRY_CATCH (e, EXCEPTION_ALL) {
+		/* A faulted link can't see the halt, so clear any error for the next halt poll */
+		if (!target_mem_poll32(t, CORTEXM_DHCSR, CORTEXM_DHCSR_S_HALT, CORTEXM_DHCSR_S_HALT, timeout))
+			target_check_error(t);
+	}
+	/* Timeouts (target in WFI) and errors alike are left for cortexm_halt_poll() to sort out */
+	(void)e;
+	return true;
+}
+
 void cortexm_halt_resume(target_s *t, bool step)
 {
 	cortexm_priv_s *priv = t->priv;
@@ -1117,6 +1312,7 @@ void cortexm_halt_resume(target_s *t, bool step)
 		target_mem_write32(t, CORTEXM_ICIALLU, 0);
 
 	target_mem_write32(t, CORTEXM_DHCSR, dhcsr);
+	cortexm_cache_forget(priv);
 }
 
 static int cortexm_fault_unwind(target_s *t)
@@ -1175,7 +1371,11 @@ static int cortexm_fault_unwind(target_s *t)
 	return 0;
 }
 
-bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+/*
+ * Load the stub's arguments and set it running without waiting for it, so the caller can stage the next
+ * block of data in another buffer while this one is being programmed. Pair with cortexm_wait_stub().
+ */
+bool cortexm_start_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
 	uint32_t regs[t->regs_size / 4U];
 
@@ -1194,12 +1394,14 @@ bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1,
 		return false;
 
 	/* Execute the stub */
-	target_halt_reason_e reason = TARGET_HALT_RUNNING;
-#if defined(PLATFORM_HAS_DEBUG)
-	uint32_t arm_regs_start[t->regs_size];
-	target_regs_read(t, arm_regs_start);
-#endif
 	cortexm_halt_resume(t, 0);
+	return true;
+}
+
+/* Wait for a stub started by cortexm_start_stub() to exit, returning its bkpt code or -1 on failure */
+int cortexm_wait_stub(target_s *t)
+{
+	target_halt_reason_e reason = TARGET_HALT_RUNNING;
 	platform_timeout_s timeout;
 	platform_timeout_set(&timeout, 5000);
 	while (reason == TARGET_HALT_RUNNING) {
@@ -1210,9 +1412,9 @@ bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1,
 			uint32_t arm_regs[t->regs_size];
 			target_regs_read(t, arm_regs);
 			for (size_t i = 0; i < 20U; i++)
-				DEBUG_WARN("%2d: %08" PRIx32 ", %08" PRIx32 "\n", i, arm_regs_start[i], arm_regs[i]);
+				DEBUG_WARN("%2d: %08" PRIx32 "\n", i, arm_regs[i]);
 #endif
-			return false;
+			return -1;
 		}
 		reason = cortexm_halt_poll(t, NULL);
 	}
@@ -1222,17 +1424,194 @@ bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1,
 
 	if (reason != TARGET_HALT_BREAKPOINT) {
 		DEBUG_WARN(" Reason %d\n", reason);
-		return false;
+		return -1;
 	}
 
 	uint32_t pc = cortexm_pc_read(t);
 	uint16_t bkpt_instr = target_mem_read16(t, pc);
 	if (bkpt_instr >> 8U != 0xbeU)
-		return false;
+		return -1;
 
 	return bkpt_instr & 0xffU;
 }
 
+/* Run the stub loaded at loadaddr, returning its exit code (the bkpt immediate) or -1 if it didn't exit cleanly */
+int cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+	if (!cortexm_start_stub(t, loadaddr, r0, r1, r2, r3))
+		return -1;
+	return cortexm_wait_stub(t);
+}
+
+/*
+ * Calls into code on the target (ROM flash routines, IAP and the like).
+ *
+ * The register file is saved once by cortexm_call_begin() and put back by the matching cortexm_call_end(), which
+ * drivers do from their flash prepare/done or enter/exit flash mode hooks. In between, each call only writes the
+ * registers it needs and reads back r0 and the PC. Calls made outside such a session save and restore the
+ * registers around themselves.
+ */
+bool cortexm_call_begin(target_s *t)
+{
+	cortexm_priv_s *priv = t->priv;
+	if (priv->call_depth) {
+		++priv->call_depth;
+		return true;
+	}
+
+	uint32_t *const context = calloc(1, t->regs_size);
+	if (!context) { /* calloc failed: heap exhaustion */
+		DEBUG_WARN("calloc: failed in %s\n", __func__);
+		return false;
+	}
+	/* The session only starts once the registers are safely saved, so a failed begin needs no end */
+	volatile exception_s e;
+	TRY_CATCH (e, EXCEPTION_ALL) {
+		target_regs_read(t, context);
+	}
+	if (e.type || target_check_error(t)) {
+		free(context);
+		if (e.type)
+			raise_exception(e.type, e.msg);
+		return false;
+	}
+	priv->call_context = context;
+	priv->call_depth = 1;
+	return true;
+}
+
+bool cortexm_call_end(target_s *t)
+{
+	cortexm_priv_s *priv = t->priv;
+	if (!priv->call_depth || --priv->call_depth)
+		return true;
+
+	target_regs_write(t, priv->call_context);
+	free(priv->call_context);
+	priv->call_context = NULL;
+	return !target_check_error(t);
+}
+
+/* Drop the saved registers and any session they belong to, for when the target is lost mid call */
+static void cortexm_call_abandon(target_s *t)
+{
+	cortexm_priv_s *priv = t->priv;
+	free(priv->call_context);
+	priv->call_context = NULL;
+	priv->call_depth = 0;
+}
+
+static void cortexm_call_reg_write(target_s *t, int reg, uint32_t value)
+{
+	cortexm_reg_write(t, reg, &value, sizeof(value));
+}
+
+/* Set up a call and let the core run it, for functions that don't come back pair with cortexm_call_wait() */
+bool cortexm_call_start(target_s *t, const cortexm_call_s *call)
+{
+	for (size_t i = 0; i < 4U; ++i)
+		cortexm_call_reg_write(t, (int)i, call->args[i]);
+	if (call->static_base)
+		cortexm_call_reg_write(t, REG_SB, call->static_base);
+	cortexm_call_reg_write(t, REG_MSP, call->stack);
+	cortexm_call_reg_write(t, REG_LR, call->return_address | 1U);
+	cortexm_call_reg_write(t, REG_PC, call->function & ~1U);
+	cortexm_call_reg_write(t, REG_XPSR, CORTEXM_XPSR_THUMB);
+	if (target_check_error(t))
+		return false;
+
+	cortexm_halt_resume(t, false);
+	return true;
+}
+
+/* Wait for a call to come back to its return address, fetching r0 into result if it's not NULL */
+bool cortexm_call_wait(target_s *t, const cortexm_call_s *call, uint32_t *result)
+{
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, call->timeout);
+	platform_timeout_s progress;
+	platform_timeout_set(&progress, 500U);
+
+	target_halt_reason_e reason = TARGET_HALT_RUNNING;
+	while (reason == TARGET_HALT_RUNNING) {
+		/* Let the probe sit on DHCSR rather than spinning on halt polls */
+		cortexm_halt_wait(t, 100U);
+		reason = cortexm_halt_poll(t, NULL);
+		if (reason != TARGET_HALT_RUNNING)
+			break;
+		if (call->show_progress)
+			target_print_progress(&progress);
+		if (call->timeout && platform_timeout_is_expired(&timeout)) {
+			DEBUG_WARN("%s: call to %08" PRIx32 " timed out after %" PRIu32 "ms\n", __func__, call->function,
+				call->timeout);
+			cortexm_halt_request(t);
+			cortexm_halt_wait(t, 100U);
+			cortexm_halt_poll(t, NULL);
+			return false;
+		}
+	}
+
+	if (reason == TARGET_HALT_ERROR)
+		raise_exception(EXCEPTION_ERROR, "Target lost in call");
+
+	const uint32_t pc = cortexm_pc_read(t);
+	if ((pc & ~1U) != (call->return_address & ~1U)) {
+		DEBUG_WARN("%s: call to %08" PRIx32 " stopped at %08" PRIx32 "\n", __func__, call->function, pc);
+		return false;
+	}
+	if (result)
+		cortexm_reg_read(t, 0, result, sizeof(*result));
+	return !target_check_error(t);
+}
+
+bool cortexm_call(target_s *t, const cortexm_call_s *call, uint32_t *result)
+{
+	if (!cortexm_call_begin(t))
+		return false;
+	volatile bool success = false;
+	volatile exception_s e;
+	TRY_CATCH (e, EXCEPTION_ALL) {
+		success = cortexm_call_start(t, call) && cortexm_call_wait(t, call, result);
+	}
+	if (e.type) {
+		/* The registers can't be put back on a target that's gone, but the next call must start afresh */
+		cortexm_call_abandon(t);
+		raise_exception(e.type, e.msg);
+	}
+	return cortexm_call_end(t) && success;
+}
+
+static const uint16_t cortexm_call_batch_stub[] = {
+#include "flashstub/call_batch.stub"
+};
+
+/*
+ * Run several calls back to back with a single resume, through a small trampoline copied to scratch RAM and
+ * followed there by the call table. call supplies the stack, return address and timeout, its function and args
+ * are ignored. Each entry's result (r0) is written back over its args[0] if results is true.
+ */
+bool cortexm_call_batch(target_s *t, const cortexm_call_s *call, const target_addr_t scratch,
+	cortexm_call_entry_s *const entries, const size_t count, const bool results)
+{
+	const target_addr_t stub = scratch;
+	const target_addr_t table = ALIGN(stub + sizeof(cortexm_call_batch_stub), 4U);
+	const cortexm_call_entry_s end = {0};
+
+	target_mem_write(t, stub, cortexm_call_batch_stub, sizeof(cortexm_call_batch_stub));
+	target_mem_write(t, table, entries, sizeof(*entries) * count);
+	target_mem_write(t, table + sizeof(*entries) * count, &end, sizeof(end));
+
+	cortexm_call_s batch = *call;
+	batch.function = stub | 1U;
+	batch.args[0] = table;
+	if (!cortexm_call(t, &batch, NULL))
+		return false;
+
+	if (results)
+		target_mem_read(t, entries, table, sizeof(*entries) * count);
+	return !target_check_error(t);
+}
+
 /* The following routines implement hardware breakpoints and watchpoints.
  * The Flash Patch and Breakpoint (FPB) and Data Watch and Trace (DWT)
  * systems are used. */
@@ -1406,6 +1785,253 @@ static bool cortexm_redirect_stdout(target_s *t, int argc, const char **argv)
 }
 #endif
 
+/*
+ * PC sampling profiler. DWT_PCSR returns the address of a recently executed instruction each time it's read,
+ * without stopping the core, so reading it back to back gives a statistical view of where the firmware spends
+ * its time. The histogram is kept here rather than streamed out so the link is spent only on sampling.
+ */
+#if PC_HOSTED == 1
+#define CORTEXM_PROFILE_SLOTS     16384U /* Must be a power of 2 */
+#define CORTEXM_PROFILE_GMON_BINS 65536U /* Upper bound on gprof histogram bins */
+#else
+#define CORTEXM_PROFILE_SLOTS 256U /* Must be a power of 2 */
+#endif
+#define CORTEXM_PROFILE_DEFAULT_MS  1000U
+#define CORTEXM_PROFILE_NO_SAMPLE   0xffffffffU /* PCSR value when halted or sampling is unimplemented */
+#define CORTEXM_PROFILE_CHECK_EVERY 256U        /* Samples between link error checks */
+
+typedef struct cortexm_profile_bin {
+	uint32_t pc;
+	uint32_t count;
+} cortexm_profile_bin_s;
+
+typedef struct cortexm_profile {
+	cortexm_profile_bin_s *bins;
+	size_t used;
+	uint32_t samples; /* PCs recorded in the histogram */
+	uint32_t missed;  /* PCSR reads that returned no sample */
+	uint32_t dropped; /* PCs lost to a full histogram */
+	uint32_t elapsed; /* Sampling time in ms */
+	bool halted;      /* Sampling stopped early as the core halted */
+} cortexm_profile_s;
+
+static void cortexm_profile_record(cortexm_profile_s *const profile, const uint32_t pc)
+{
+	/* Open addressing with linear probing; Thumb PCs are halfword aligned so drop bit 0 before hashing */
+	size_t slot = ((pc >> 1U) * 0x9e3779b1U) & (CORTEXM_PROFILE_SLOTS - 1U);
+	for (size_t probe = 0; probe < CORTEXM_PROFILE_SLOTS; ++probe) {
+		cortexm_profile_bin_s *const bin = &profile->bins[slot];
+		if (!bin->count) {
+			bin->pc = pc;
+			bin->count = 1U;
+			++profile->used;
+			++profile->samples;
+			return;
+		}
+		if (bin->pc == pc) {
+			++bin->count;
+			++profile->samples;
+			return;
+		}
+		slot = (slot + 1U) & (CORTEXM_PROFILE_SLOTS - 1U);
+	}
+	++profile->dropped;
+}
+
+static bool cortexm_profile_sample(target_s *const t, cortexm_profile_s *const profile, const uint32_t duration)
+{
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, duration);
+	const uint32_t start = platform_time_ms();
+	for (uint32_t reads = 1U; !platform_timeout_is_expired(&timeout); ++reads) {
+		const uint32_t pc = target_mem_read32(t, CORTEXM_DWT_PCSR);
+		if (pc != CORTEXM_PROFILE_NO_SAMPLE)
+			cortexm_profile_record(profile, pc);
+		else {
+			++profile->missed;
+			/* A breakpoint or semihosting call stops the core, and with it the samples */
+			if (target_mem_read32(t, CORTEXM_DHCSR) & CORTEXM_DHCSR_S_HALT) {
+				profile->halted = true;
+				break;
+			}
+		}
+		if (!(reads % CORTEXM_PROFILE_CHECK_EVERY) && target_check_error(t))
+			return false;
+	}
+	profile->elapsed = platform_time_ms() - start;
+	return !target_check_error(t);
+}
+
+static int cortexm_profile_bin_compare(const void *const lhs, const void *const rhs)
+{
+	const cortexm_profile_bin_s *const a = (const cortexm_profile_bin_s *)lhs;
+	const cortexm_profile_bin_s *const b = (const cortexm_profile_bin_s *)rhs;
+	/* Hottest first, unused slots sink to the end */
+	if (a->count != b->count)
+		return a->count > b->count ? -1 : 1;
+	return a->pc < b->pc ? -1 : a->pc > b->pc;
+}
+
+#if PC_HOSTED == 1
+static void cortexm_profile_put_le32(uint8_t *const buffer, const uint32_t value)
+{
+	buffer[0] = value & 0xffU;
+	buffer[1] = (value >> 8U) & 0xffU;
+	buffer[2] = (value >> 16U) & 0xffU;
+	buffer[3] = value >> 24U;
+}
+
+/*
+ * Write a gprof gmon.out holding just a time histogram (tag 0) for a 32-bit little endian target.
+ * Bins start at 2 bytes, one per Thumb instruction, and widen when the sampled PCs span too much address space.
+ */
+static bool cortexm_profile_write_gmon(const cortexm_profile_s *const profile, FILE *const file)
+{
+	uint32_t low_pc = UINT32_MAX;
+	uint32_t high_pc = 0;
+	for (size_t i = 0; i < profile->used; ++i) {
+		low_pc = MIN(low_pc, profile->bins[i].pc);
+		high_pc = MAX(high_pc, profile->bins[i].pc);
+	}
+	uint32_t bin_size = 2U;
+	while ((high_pc - low_pc) / bin_size >= CORTEXM_PROFILE_GMON_BINS)
+		bin_size <<= 1U;
+	low_pc &= ~(bin_size - 1U);
+	const uint32_t bin_count = (high_pc - low_pc) / bin_size + 1U;
+	high_pc = low_pc + bin_count * bin_size;
+
+	uint32_t *const hist = calloc(bin_count, sizeof(*hist));
+	if (!hist) { /* calloc failed: heap exhaustion */
+		DEBUG_WARN("calloc: failed in %s\n", __func__);
+		return false;
+	}
+	for (size_t i = 0; i < profile->used; ++i)
+		hist[(profile->bins[i].pc - low_pc) / bin_size] += profile->bins[i].count;
+
+	/* Every PCSR read counts towards the rate so the times gprof reports match wall clock */
+	const uint32_t reads = profile->samples + profile->missed + profile->dropped;
+	const uint32_t rate = MAX(1U, (uint32_t)(((uint64_t)reads * 1000U) / MAX(1U, profile->elapsed)));
+
+	uint8_t header[53] = {'g', 'm', 'o', 'n'};
+	cortexm_profile_put_le32(header + 4U, 1U); /* version, followed by 12 spare bytes */
+	header[20] = 0U;                           /* GMON_TAG_TIME_HIST */
+	cortexm_profile_put_le32(header + 21U, low_pc);
+	cortexm_profile_put_le32(header + 25U, high_pc);
+	cortexm_profile_put_le32(header + 29U, bin_count);
+	cortexm_profile_put_le32(header + 33U, rate);
+	memcpy(header + 37U, "seconds", 7U); /* 15 byte dimension, NUL padded */
+	header[52] = 's';
+
+	bool result = fwrite(header, sizeof(header), 1U, file) == 1U;
+	for (uint32_t i = 0; result && i < bin_count; ++i) {
+		const uint16_t count = MIN(hist[i], UINT16_MAX);
+		const uint8_t value[2] = {count & 0xffU, count >> 8U};
+		result = fwrite(value, sizeof(value), 1U, file) == 1U;
+	}
+	free(hist);
+	return result;
+}
+#endif
+
+/*
+ * Emit one "frame count" line per sampled PC, the folded stack format flamegraph.pl and speedscope take.
+ * There is no unwinding here so every stack is a single frame; symbolise the addresses with addr2line.
+ */
+static bool cortexm_profile_write_folded(target_s *const t, const cortexm_profile_s *const profile, FILE *const file)
+{
+#if PC_HOSTED == 1
+	if (file) {
+		for (size_t i = 0; i < profile->used; ++i) {
+			if (fprintf(file, "0x%08" PRIx32 " %" PRIu32 "\n", profile->bins[i].pc, profile->bins[i].count) < 0)
+				return false;
+		}
+		return true;
+	}
+#else
+	(void)file;
+#endif
+	for (size_t i = 0; i < profile->used; ++i)
+		tc_printf(t, "0x%08" PRIx32 " %" PRIu32 "\n", profile->bins[i].pc, profile->bins[i].count);
+	return true;
+}
+
+static bool cortexm_profile(target_s *t, int argc, const char **argv)
+{
+	uint32_t duration = CORTEXM_PROFILE_DEFAULT_MS;
+	if (argc > 1)
+		duration = strtoul(argv[1], NULL, 0);
+	bool gmon = false;
+	if (argc > 2) {
+		gmon = !strcmp(argv[2], "gmon");
+		if (!gmon && strcmp(argv[2], "folded") != 0) {
+			tc_printf(t, "usage: monitor profile [ms [folded|gmon [file]]]\n");
+			return false;
+		}
+	}
+#if PC_HOSTED == 1
+	const char *const filename = argc > 3 ? argv[3] : gmon ? "gmon.out" : NULL;
+#else
+	if (gmon || argc > 3) {
+		tc_printf(t, "gmon.out and file output are only available from BMDA\n");
+		return false;
+	}
+#endif
+
+	cortexm_profile_s profile = {0};
+	profile.bins = calloc(CORTEXM_PROFILE_SLOTS, sizeof(*profile.bins));
+	if (!profile.bins) { /* calloc failed: heap exhaustion */
+		DEBUG_WARN("calloc: failed in %s\n", __func__);
+		return false;
+	}
+
+	/* GDB only lets monitor commands through while the core is stopped, so run it for the sampling window */
+	const bool was_halted = target_mem_read32(t, CORTEXM_DHCSR) & CORTEXM_DHCSR_S_HALT;
+	if (was_halted)
+		target_halt_resume(t, false);
+	bool result = cortexm_profile_sample(t, &profile, duration);
+	if (was_halted && !profile.halted) {
+		target_halt_request(t);
+		platform_timeout_s timeout;
+		platform_timeout_set(&timeout, cortexm_wait_timeout);
+		while (target_halt_poll(t, NULL) == TARGET_HALT_RUNNING && !platform_timeout_is_expired(&timeout))
+			continue;
+	}
+	if (!result) {
+		tc_printf(t, "Link error while sampling, profile discarded\n");
+		free(profile.bins);
+		return false;
+	}
+	if (!profile.samples)
+		tc_printf(t, "No PC samples, DWT_PCSR is not implemented on this core or it is sleeping\n");
+
+	qsort(profile.bins, CORTEXM_PROFILE_SLOTS, sizeof(*profile.bins), cortexm_profile_bin_compare);
+#if PC_HOSTED == 1
+	if (filename && profile.samples) {
+		FILE *const file = fopen(filename, gmon ? "wb" : "w");
+		if (!file) {
+			DEBUG_WARN("Error opening %s for writing: %s\n", filename, strerror(errno));
+			free(profile.bins);
+			return false;
+		}
+		result = gmon ? cortexm_profile_write_gmon(&profile, file) : cortexm_profile_write_folded(t, &profile, file);
+		if (fclose(file) != 0 || !result) {
+			DEBUG_WARN("Error writing %s\n", filename);
+			result = false;
+		} else
+			tc_printf(t, "Profile written to %s\n", filename);
+	} else
+		cortexm_profile_write_folded(t, &profile, NULL);
+#else
+	cortexm_profile_write_folded(t, &profile, NULL);
+#endif
+	tc_printf(t, "%" PRIu32 " samples at %" PRIu32 " distinct PCs over %" PRIu32 "ms, %" PRIu32 " missed, %" PRIu32
+				 " dropped%s\n",
+		profile.samples, (uint32_t)profile.used, profile.elapsed, profile.missed, profile.dropped,
+		profile.halted ? ", stopped early as the core halted" : "");
+	free(profile.bins);
+	return result;
+}
+
 #if PC_HOSTED == 0
 /* probe memory access functions */
 static void probe_mem_read(target_s *t __attribute__((unused)), void *probe_dest, target_addr_t target_src, size_t len)
@@ -1429,6 +2055,103 @@ static void probe_mem_write(
 }
 #endif
 
+/* Size of the chunks the console fast path reads target memory in, must be a power of 2 */
+#define CORTEXM_CONSOLE_CHUNK 64U
+
+static void cortexm_console_write(const int fd, const uint8_t *const data, const size_t len)
+{
+#if PC_HOSTED == 0
+	(void)fd;
+	debug_serial_send_stdout(data, len);
+#else
+	if (write(fd, data, len) < 0)
+		DEBUG_WARN("Semihosting console write failed: %s\n", strerror(errno));
+#endif
+}
+
+/*
+ * Copy len bytes of target memory at addr to the console, or if len is 0, the NUL terminated string
+ * there. Reads are done a chunk at a time, never crossing a chunk boundary so that scanning for
+ * the end of a string can't run off the end of mapped memory. Returns false if a read fails, with
+ * written set to how many bytes made it to the console before that.
+ */
+static bool cortexm_console_copy(target_s *t, const int fd, target_addr_t addr, size_t len, size_t *const written)
+{
+	*written = 0;
+	const bool string = len == 0;
+	while (string || len) {
+		uint8_t buf[CORTEXM_CONSOLE_CHUNK];
+		size_t amount = CORTEXM_CONSOLE_CHUNK - (addr & (CORTEXM_CONSOLE_CHUNK - 1U));
+		if (!string && amount > len)
+			amount = len;
+		if (target_mem_read(t, buf, addr, amount))
+			return false;
+		if (string) {
+			const uint8_t *const end = memchr(buf, 0, amount);
+			if (end) {
+				cortexm_console_write(fd, buf, end - buf);
+				*written += end - buf;
+				return true;
+			}
+		} else
+			len -= amount;
+		cortexm_console_write(fd, buf, amount);
+		*written += amount;
+		addr += amount;
+	}
+	return true;
+}
+
+/*
+ * Fast path for semihosting console output: SYS_WRITEC, SYS_WRITE0 and SYS_WRITE to stdout or stderr.
+ * These are serviced entirely on the probe, copying the data out in blocks and touching only the
+ * registers involved, so the target can be resumed straight away. On the firmware this applies when
+ * stdout is redirected to the aux serial port; BMDA always writes the console out itself.
+ * Returns false if the request needs to go through cortexm_hostio_request() instead.
+ */
+static bool cortexm_hostio_console(target_s *t)
+{
+#if PC_HOSTED == 0
+	if (!t->stdout_redirected)
+		return false;
+#endif
+	uint32_t syscall = 0;
+	uint32_t arg = 0;
+	cortexm_reg_read(t, 0, &syscall, sizeof(syscall));
+	if (syscall != SEMIHOSTING_SYS_WRITEC && syscall != SEMIHOSTING_SYS_WRITE0 && syscall != SEMIHOSTING_SYS_WRITE)
+		return false;
+	cortexm_reg_read(t, 1, &arg, sizeof(arg));
+	if (arg == 0U)
+		return false;
+
+	/*
+	 * Once any output has been emitted the request is finished here even if a later read fails, as
+	 * the full hostio path would print it all again. Only SYS_WRITE has a way to report the shortfall.
+	 */
+	size_t written = 0;
+	switch (syscall) {
+	case SEMIHOSTING_SYS_WRITEC:
+		return cortexm_console_copy(t, STDERR_FILENO, arg, 1U, &written);
+	case SEMIHOSTING_SYS_WRITE0:
+		return cortexm_console_copy(t, STDERR_FILENO, arg, 0U, &written) || written;
+	default: {
+		/* params are the handle, buffer address and length; handles are fds offset by 1 */
+		uint32_t params[3];
+		if (target_mem_read(t, params, arg, sizeof(params)))
+			return false;
+		const int fd = (int)params[0] - 1;
+		if (fd != STDOUT_FILENO && fd != STDERR_FILENO)
+			return false;
+		if (params[2] && !cortexm_console_copy(t, fd, params[1], params[2], &written) && !written)
+			return false;
+		/* SYS_WRITE returns the number of bytes not written */
+		const uint32_t result = params[2] ? params[2] - written : 0U;
+		cortexm_reg_write(t, 0, &result, sizeof(result));
+		return true;
+	}
+	}
+}
+
 static int cortexm_hostio_request(target_s *t)
 {
 	uint32_t arm_regs[t->regs_size];
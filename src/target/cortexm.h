@@ -49,7 +49,9 @@ extern unsigned cortexm_wait_timeout;
 /* Cache maintenance operations */
 #define CORTEXM_ICIALLU  (CORTEXM_SCS_BASE + 0xf50U)
 #define CORTEXM_DCCMVAC  (CORTEXM_SCS_BASE + 0xf68U)
+#define CORTEXM_DCCSW    (CORTEXM_SCS_BASE + 0xf6cU)
 #define CORTEXM_DCCIMVAC (CORTEXM_SCS_BASE + 0xf70U)
+#define CORTEXM_DCCISW   (CORTEXM_SCS_BASE + 0xf74U)
 
 #define CORTEXM_FPB_BASE (CORTEXM_PPB_BASE + 0x2000U)
 
@@ -61,6 +63,7 @@ extern unsigned cortexm_wait_timeout;
 #define CORTEXM_DWT_BASE (CORTEXM_PPB_BASE + 0x1000U)
 
 #define CORTEXM_DWT_CTRL    (CORTEXM_DWT_BASE + 0x000U)
+#define CORTEXM_DWT_PCSR    (CORTEXM_DWT_BASE + 0x01cU)
 #define CORTEXM_DWT_COMP(i) (CORTEXM_DWT_BASE + 0x020U + (0x10U * (i)))
 #define CORTEXM_DWT_MASK(i) (CORTEXM_DWT_BASE + 0x024U + (0x10U * (i)))
 #define CORTEXM_DWT_FUNC(i) (CORTEXM_DWT_BASE + 0x028U + (0x10U * (i)))
@@ -137,6 +140,11 @@ extern unsigned cortexm_wait_timeout;
 /* Bits 3:1 - Reserved */
 #define CORTEXM_DEMCR_VC_CORERESET (1U << 0U)
 
+/* Cache Size ID Register (CCSIDR) */
+#define CORTEXM_CCSIDR_LINESIZE(ccsidr)      ((ccsidr) & 0x7U)
+#define CORTEXM_CCSIDR_ASSOCIATIVITY(ccsidr) (((ccsidr) >> 3U) & 0x3ffU)
+#define CORTEXM_CCSIDR_NUMSETS(ccsidr)       (((ccsidr) >> 13U) & 0x7fffU)
+
 /* Flash Patch and Breakpoint Control Register (FP_CTRL) */
 /* Bits 32:15 - Reserved */
 /* Bits 14:12 - NUM_CODE2 */ /* v7m only */
@@ -160,6 +168,7 @@ extern unsigned cortexm_wait_timeout;
 #define CORTEXM_DWT_FUNC_FUNC_WRITE     (6U << 0U)
 #define CORTEXM_DWT_FUNC_FUNC_ACCESS    (7U << 0U)
 
+#define REG_SB      9U /* AAPCS static base */
 #define REG_SP      13U
 #define REG_LR      14U
 #define REG_PC      15U
@@ -190,8 +199,36 @@ adiv5_access_port_s *cortexm_ap(target_s *t);
 
 bool cortexm_attach(target_s *t);
 void cortexm_detach(target_s *t);
+void cortexm_reset(target_s *t);
 void cortexm_halt_resume(target_s *t, bool step);
-bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+int cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+bool cortexm_start_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+int cortexm_wait_stub(target_s *t);
+
+/* A call into a function on the target, see cortexm_call_begin() */
+typedef struct cortexm_call {
+	uint32_t function;       /* Entry point of the function */
+	uint32_t args[4];        /* Loaded into r0-r3 */
+	uint32_t stack;          /* Initial MSP */
+	uint32_t static_base;    /* Loaded into r9 for position independent code if not 0 */
+	uint32_t return_address; /* Where the function returns to, a breakpoint must be waiting there */
+	uint32_t timeout;        /* In ms, 0 waits for as long as it takes */
+	bool show_progress;      /* Print the progress spinner while waiting */
+} cortexm_call_s;
+
+/* One entry of a batch run by cortexm_call_batch(), as laid out in target RAM */
+typedef struct cortexm_call_entry {
+	uint32_t function;
+	uint32_t args[4];
+} cortexm_call_entry_s;
+
+bool cortexm_call_begin(target_s *t);
+bool cortexm_call_end(target_s *t);
+bool cortexm_call_start(target_s *t, const cortexm_call_s *call);
+bool cortexm_call_wait(target_s *t, const cortexm_call_s *call, uint32_t *result);
+bool cortexm_call(target_s *t, const cortexm_call_s *call, uint32_t *result);
+bool cortexm_call_batch(target_s *t, const cortexm_call_s *call, target_addr_t scratch, cortexm_call_entry_s *entries,
+	size_t count, bool results);
 int cortexm_mem_write_sized(target_s *t, target_addr_t dest, const void *src, size_t len, align_e align);
 
 #endif /* TARGET_CORTEXM_H */
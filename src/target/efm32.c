@@ -508,6 +508,7 @@ static void efm32_add_flash(target_s *t, target_addr_t addr, size_t length, size
 	f->erase = efm32_flash_erase;
 	f->write = efm32_flash_write;
 	f->writesize = page_size;
+	f->erased = 0xffU;
 	target_add_flash(t, f);
 }
 
@@ -0,0 +1,46 @@
+@ This file is part of the Black Magic Debug project.
+@
+@ This program is free software: you can redistribute it and/or modify
+@ it under the terms of the GNU General Public License as published by
+@ the Free Software Foundation, either version 3 of the License, or
+@ (at your option) any later version.
+@
+@ This program is distributed in the hope that it will be useful,
+@ but WITHOUT ANY WARRANTY; without even the implied warranty of
+@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+@ GNU General Public License for more details.
+@
+@ You should have received a copy of the GNU General Public License
+@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+@ Call trampoline for cortexm_call_batch(), so several target functions run back to back from one resume.
+@ Thumb-1 only so it runs on every Cortex-M.
+@
+@ r0 = call table, entries of {function, r0, r1, r2, r3} ended by a zero function
+@
+@ Each function's return value is stored over its r0 entry. Returns to the caller's lr like a normal function.
+
+	.syntax unified
+	.thumb
+	.text
+
+	.global cortexm_call_batch_stub
+	.type cortexm_call_batch_stub, %function
+cortexm_call_batch_stub:
+	push {r4, r5, r6, lr}
+	movs r4, r0
+next:
+	ldr r5, [r4]
+	cmp r5, #0
+	beq done
+	ldr r0, [r4, #4]
+	ldr r1, [r4, #8]
+	ldr r2, [r4, #12]
+	ldr r3, [r4, #16]
+	blx r5
+	str r0, [r4, #4]
+	adds r4, #20
+	b next
+done:
+	pop {r4, r5, r6, pc}
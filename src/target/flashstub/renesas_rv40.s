@@ -0,0 +1,77 @@
+@ This file is part of the Black Magic Debug project.
+@
+@ This program is free software: you can redistribute it and/or modify
+@ it under the terms of the GNU General Public License as published by
+@ the Free Software Foundation, either version 3 of the License, or
+@ (at your option) any later version.
+@
+@ This program is distributed in the hope that it will be useful,
+@ but WITHOUT ANY WARRANTY; without even the implied warranty of
+@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+@ GNU General Public License for more details.
+@
+@ You should have received a copy of the GNU General Public License
+@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+@ Renesas RA RV40 code flash programming through the FACI command area.
+@
+@ Each 128 byte program unit is handed to the FACI as 0xe8, 0x40, 64 halfwords and 0xd0 to the command area,
+@ waiting out FSTATR.DBFULL between halfwords and FSTATR.FRDY at the end of the unit. The debugger has already
+@ entered code flash P/E mode.
+@
+@ r0 = destination in code flash, 128 byte aligned
+@ r1 = source buffer in SRAM, halfword aligned
+@ r2 = length in bytes, a multiple of 128
+@ r3 = address of FSTATR (FSADDR sits at FSTATR - 0x50)
+@
+@ Exits with bkpt #0 on success, or bkpt #1 as soon as FSTATR reports an error so the debugger can recover the FACI.
+
+	.syntax unified
+	.thumb
+	.text
+
+	.global renesas_rv40_program_stub
+	.type renesas_rv40_program_stub, %function
+renesas_rv40_program_stub:
+	ldr r4, cmd_area
+	ldr r7, error_mask
+unit:
+	cbz r2, done
+	str r0, [r3, #-0x50] @ FSADDR
+	movs r5, #0xe8       @ Program
+	strb r5, [r4]
+	movs r5, #0x40       @ 64 halfwords
+	strb r5, [r4]
+	movs r6, #0x40
+halfword:
+	ldrh r5, [r1], #2
+	strh r5, [r4]
+dbfull:
+	ldr r5, [r3]
+	tst r5, #0x400       @ FSTATR.DBFULL
+	bne dbfull
+	subs r6, #1
+	bne halfword
+	movs r5, #0xd0       @ Final
+	strb r5, [r4]
+frdy:
+	ldr r5, [r3]
+	tst r5, #0x8000      @ FSTATR.FRDY
+	beq frdy
+	tst r5, r7
+	bne error
+	adds r0, #0x80
+	subs r2, #0x80
+	b unit
+done:
+	bkpt #0
+error:
+	bkpt #1
+
+	.align 2
+cmd_area:
+	.word 0x407e0000
+error_mask:
+	@ FSTATR.PRGERR | ILGLERR | OTERR | SECERR | FESETERR | ILGCOMERR
+	.word 0x00f05000
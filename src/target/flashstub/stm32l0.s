@@ -0,0 +1,63 @@
+@ This file is part of the Black Magic Debug project.
+@
+@ This program is free software: you can redistribute it and/or modify
+@ it under the terms of the GNU General Public License as published by
+@ the Free Software Foundation, either version 3 of the License, or
+@ (at your option) any later version.
+@
+@ This program is distributed in the hope that it will be useful,
+@ but WITHOUT ANY WARRANTY; without even the implied warranty of
+@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+@ GNU General Public License for more details.
+@
+@ You should have received a copy of the GNU General Public License
+@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@ STM32L0/L1 half-page programming (NVM_PECR PROG | FPRG, set up by the debugger).
+@
+@ The half page's words have to reach the NVM interface back to back, which the debug link can't promise,
+@ so they're written from here. Thumb-1 only, as the L0 parts are Cortex-M0+. The stub is loaded once per
+@ flash operation and each run programs as many consecutive half pages as it's given.
+@
+@ r0 = destination in flash, half-page aligned
+@ r1 = half-page length in bytes
+@ r2 = length in bytes, a non-zero multiple of the half-page length
+@ r3 = address of NVM_SR
+@ The data follows the stub in SRAM, starting at the first word boundary after it.
+@
+@ Exits with bkpt #0 once every half page is programmed and the NVM is idle again, or with bkpt #1 as soon as
+@ NVM_SR reports an error. r2 then holds the length not yet programmed, including the half page that failed.
+
+	.syntax unified
+	.thumb
+	.text
+
+	.equ NVM_SR_ERR_M, 0x10700 @ NOTZEROERR | SIZERR | PGAERR | WRPERR
+
+	.global stm32lx_nvm_half_page_stub
+	.type stm32lx_nvm_half_page_stub, %function
+stm32lx_nvm_half_page_stub:
+	adr r4, data
+half_page:
+	movs r5, r1
+copy:
+	ldmia r4!, {r6}
+	stmia r0!, {r6}
+	subs r5, #4
+	bne copy
+busy:
+	ldr r6, [r3]
+	lsrs r7, r6, #1 @ NVM_SR_BSY (bit 0) into the carry
+	bcs busy
+	ldr r7, =NVM_SR_ERR_M
+	tst r6, r7
+	bne error
+	subs r2, r2, r1
+	bne half_page
+	bkpt #0
+error:
+	bkpt #1
+
+	.ltorg
+	.align 2
+data:
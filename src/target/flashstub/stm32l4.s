@@ -0,0 +1,66 @@
+@ This file is part of the Black Magic Debug project.
+@
+@ This program is free software: you can redistribute it and/or modify
+@ it under the terms of the GNU General Public License as published by
+@ the Free Software Foundation, either version 3 of the License, or
+@ (at your option) any later version.
+@
+@ This program is distributed in the hope that it will be useful,
+@ but WITHOUT ANY WARRANTY; without even the implied warranty of
+@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+@ GNU General Public License for more details.
+@
+@ You should have received a copy of the GNU General Public License
+@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@ STM32L4/G4/WB/WL fast row programming (FLASH_CR_FSTPG).
+@
+@ Once the first double word of a row is written the controller keeps the programming voltage up and expects
+@ the remaining 31 to follow with no gaps, which the debug link can't guarantee, so this runs from SRAM.
+@
+@ r0 = destination in flash, 256-byte row aligned
+@ r1 = source buffer in SRAM, word aligned
+@ r2 = length in bytes, a non-zero multiple of the row size
+@ r3 = address of FLASH_SR, with FLASH_CR directly after it
+@
+@ Exits with bkpt #0 on success or bkpt #1 if FLASH_SR reports an error, FSTPG is cleared either way.
+
+	.syntax unified
+	.thumb
+	.text
+
+	.equ FLASH_CR_FSTPG, (1 << 18)
+	.equ FLASH_SR_ERROR_MASK, 0xc3fa
+	.equ ROW_DWORDS, 32
+	.equ ROW_BYTES, (ROW_DWORDS * 8)
+
+	.global stm32l4_flash_fast_write_stub
+	.type stm32l4_flash_fast_write_stub, %function
+stm32l4_flash_fast_write_stub:
+	ldr r4, =FLASH_CR_FSTPG
+	str r4, [r3, #4]
+row:
+	movs r5, #ROW_DWORDS
+dword:
+	ldmia r1!, {r6, r7}
+	stmia r0!, {r6, r7}
+	subs r5, #1
+	bne dword
+busy:
+	ldr r6, [r3]
+	lsls r7, r6, #15 @ FLASH_SR_BSY (bit 16) into the sign bit
+	bmi busy
+	ldr r7, =FLASH_SR_ERROR_MASK
+	tst r6, r7
+	bne error
+	subs r2, #ROW_BYTES
+	bne row
+	movs r4, #0
+	str r4, [r3, #4]
+	bkpt #0
+error:
+	movs r4, #0
+	str r4, [r3, #4]
+	bkpt #1
+
+	.ltorg
@@ -0,0 +1,741 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2022 1BitSquared <info@1bitsquared.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements support for CMSIS-Pack flash algorithms (.FLM files).
+ *
+ * An FLM is a position independent ELF image holding the algorithm's code (PrgCode), its data (PrgData), a
+ * FlashDevice description of the Flash it drives (DevDscr), and the Init, UnInit, EraseSector, ProgramPage and
+ * optionally EraseChip entry points. The image is staged to target RAM followed by a breakpoint for the entry
+ * points to return to, two page buffers so the next page can be uploaded while the current one is programmed,
+ * and a stack. The algorithm expects r9 to hold the address of PrgData.
+ *
+ * References:
+ * https://arm-software.github.io/CMSIS_5/Pack/html/algorithmFunc.html
+ * https://arm-software.github.io/CMSIS_5/Pack/html/flashAlgorithm.html
+ */
+
+#include "general.h"
+#include "target.h"
+#include "target_internal.h"
+#include "cortexm.h"
+#include "flm.h"
+
+#if PC_HOSTED == 1
+#include <errno.h>
+#endif
+
+#define FLM_ELF_MAGIC       "\177ELF"
+#define FLM_ELF_CLASS_32    1U
+#define FLM_ELF_DATA_LSB    1U
+#define FLM_ELF_MACHINE_ARM 40U
+
+#define FLM_ELF_SHT_PROGBITS 1U
+#define FLM_ELF_SHT_SYMTAB   2U
+#define FLM_ELF_SHF_ALLOC    (1U << 1U)
+
+#define FLM_SYMBOL_NAME_MAX 16U
+
+/* Values for the fnc argument of Init and UnInit */
+#define FLM_OPERATION_NONE    0U
+#define FLM_OPERATION_ERASE   1U
+#define FLM_OPERATION_PROGRAM 2U
+
+#define FLM_DEVICE_NAME_LENGTH 128U
+#define FLM_SECTORS_MAX        512U
+#define FLM_SECTOR_END         0xffffffffU
+
+#define FLM_IMAGE_MAX       0x40000U /* No algorithm image should need more target RAM than this */
+#define FLM_STACK_SIZE      1024U
+#define FLM_WRITE_UNITS     8U    /* Pages handed to ProgramPage back to back per write call */
+#define FLM_INIT_TIMEOUT_MS 1000U /* Init and UnInit don't come with a timeout of their own */
+
+typedef struct flm_elf_header {
+	uint8_t ident[16];
+	uint16_t type;
+	uint16_t machine;
+	uint32_t version;
+	uint32_t entry;
+	uint32_t program_header_offset;
+	uint32_t section_header_offset;
+	uint32_t flags;
+	uint16_t header_size;
+	uint16_t program_header_size;
+	uint16_t program_header_count;
+	uint16_t section_header_size;
+	uint16_t section_header_count;
+	uint16_t section_name_index;
+} flm_elf_header_s;
+
+typedef struct flm_elf_section {
+	uint32_t name;
+	uint32_t type;
+	uint32_t flags;
+	uint32_t address;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t link;
+	uint32_t info;
+	uint32_t alignment;
+	uint32_t entry_size;
+} flm_elf_section_s;
+
+typedef struct flm_elf_symbol {
+	uint32_t name;
+	uint32_t value;
+	uint32_t size;
+	uint8_t info;
+	uint8_t other;
+	uint16_t section;
+} flm_elf_symbol_s;
+
+/* The fixed part of the FlashDevice structure from FlashOS.h, followed by up to FLM_SECTORS_MAX sector entries */
+typedef struct flm_device {
+	uint16_t version;
+	char name[FLM_DEVICE_NAME_LENGTH];
+	uint16_t type;
+	uint32_t address;
+	uint32_t size;
+	uint32_t page_size;
+	uint32_t reserved;
+	uint8_t erased_value;
+	uint8_t padding[3];
+	uint32_t program_timeout;
+	uint32_t erase_timeout;
+} flm_device_s;
+
+typedef struct flm_sector {
+	uint32_t size;
+	uint32_t offset; /* From the start of the device */
+} flm_sector_s;
+
+/* Where the FLM is being read from, either host memory (BMDA) or a copy uploaded to target RAM */
+typedef struct flm_file {
+	target_s *t;
+	const uint8_t *data;
+	target_addr_t address;
+	size_t length;
+} flm_file_s;
+
+/* The algorithm as staged to target RAM, shared by all the Flash regions made from the one FLM */
+typedef struct flm_image {
+	target_addr_t address;
+	size_t length;
+	uint8_t *data;
+} flm_image_s;
+
+typedef struct flm_flash {
+	target_flash_s f;
+	flm_image_s image; /* The first region made from an FLM holds the image data, the rest point at it */
+	uint32_t device_address;
+	uint32_t init;
+	uint32_t uninit;
+	uint32_t erase_sector;
+	uint32_t erase_chip; /* 0 if the algorithm has no EraseChip */
+	uint32_t program_page;
+	uint32_t static_base;
+	uint32_t return_address;
+	uint32_t stack;
+	uint32_t buffer[2];
+	uint32_t program_timeout;
+	uint32_t erase_timeout;
+	uint8_t operation; /* What the algorithm was last Init'd for */
+	cortexm_call_s erase_call; /* The erase left running for flm_flash_erase_wait() */
+	uint8_t image_storage[];
+} flm_flash_s;
+
+typedef struct flm_symbols {
+	uint32_t init;
+	uint32_t uninit;
+	uint32_t erase_sector;
+	uint32_t erase_chip;
+	uint32_t program_page;
+	uint32_t device;
+	uint16_t device_section;
+	bool found_init;
+	bool found_uninit;
+	bool found_erase_sector;
+	bool found_program_page;
+	bool found_device;
+} flm_symbols_s;
+
+static bool flm_flash_prepare(target_flash_s *f);
+static bool flm_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
+static bool flm_flash_erase_wait(target_flash_s *f);
+static bool flm_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
+static bool flm_flash_done(target_flash_s *f);
+
+static bool flm_read(const flm_file_s *const file, const uint32_t offset, void *const buffer, const size_t length)
+{
+	if (offset > file->length || length > file->length - offset) {
+		DEBUG_WARN("FLM: read of %" PRIu32 " bytes at 0x%" PRIx32 " is past the end of the file\n", (uint32_t)length,
+			offset);
+		return false;
+	}
+	if (file->data)
+		memcpy(buffer, file->data + offset, length);
+	else {
+		target_mem_read(file->t, buffer, file->address + offset, length);
+		if (target_check_error(file->t))
+			return false;
+	}
+	return true;
+}
+
+static bool flm_read_section(const flm_file_s *const file, const flm_elf_header_s *const header, const size_t index,
+	flm_elf_section_s *const section)
+{
+	if (index >= header->section_header_count)
+		return false;
+	return flm_read(file, header->section_header_offset + (index * header->section_header_size), section,
+		sizeof(*section));
+}
+
+static bool flm_read_string(const flm_file_s *const file, const flm_elf_section_s *const strings,
+	const uint32_t offset, char *const buffer, const size_t length)
+{
+	if (offset >= strings->size)
+		return false;
+	const size_t read_length = MIN(length - 1U, strings->size - offset);
+	if (!flm_read(file, strings->offset + offset, buffer, read_length))
+		return false;
+	buffer[read_length] = '\0';
+	return true;
+}
+
+static void flm_match_symbol(flm_symbols_s *const symbols, const char *const name, const flm_elf_symbol_s *symbol)
+{
+	if (!strcmp(name, "Init")) {
+		symbols->init = symbol->value;
+		symbols->found_init = true;
+	} else if (!strcmp(name, "UnInit")) {
+		symbols->uninit = symbol->value;
+		symbols->found_uninit = true;
+	} else if (!strcmp(name, "EraseSector")) {
+		symbols->erase_sector = symbol->value;
+		symbols->found_erase_sector = true;
+	} else if (!strcmp(name, "EraseChip"))
+		symbols->erase_chip = symbol->value;
+	else if (!strcmp(name, "ProgramPage")) {
+		symbols->program_page = symbol->value;
+		symbols->found_program_page = true;
+	} else if (!strcmp(name, "FlashDevice")) {
+		symbols->device = symbol->value;
+		symbols->device_section = symbol->section;
+		symbols->found_device = true;
+	}
+}
+
+static bool flm_read_symbols(
+	const flm_file_s *const file, const flm_elf_header_s *const header, flm_symbols_s *const symbols)
+{
+	memset(symbols, 0, sizeof(*symbols));
+	for (size_t index = 0; index < header->section_header_count; ++index) {
+		flm_elf_section_s symbol_table;
+		if (!flm_read_section(file, header, index, &symbol_table))
+			return false;
+		if (symbol_table.type != FLM_ELF_SHT_SYMTAB)
+			continue;
+		flm_elf_section_s strings;
+		if (!flm_read_section(file, header, symbol_table.link, &strings))
+			return false;
+
+		for (uint32_t offset = 0; offset + sizeof(flm_elf_symbol_s) <= symbol_table.size;
+			 offset += sizeof(flm_elf_symbol_s)) {
+			flm_elf_symbol_s symbol;
+			char name[FLM_SYMBOL_NAME_MAX];
+			if (!flm_read(file, symbol_table.offset + offset, &symbol, sizeof(symbol)))
+				return false;
+			if (!symbol.name || !flm_read_string(file, &strings, symbol.name, name, sizeof(name)))
+				continue;
+			flm_match_symbol(symbols, name, &symbol);
+		}
+	}
+	return symbols->found_init && symbols->found_uninit && symbols->found_erase_sector &&
+		symbols->found_program_page && symbols->found_device;
+}
+
+/*
+ * Build the RAM image of the algorithm from its allocated sections, leaving out the FlashDevice description.
+ * The image is linked at 0, so each section goes at its own address and NOBITS sections are left zeroed.
+ */
+static bool flm_read_image(const flm_file_s *const file, const flm_elf_header_s *const header,
+	const flm_symbols_s *const symbols, uint8_t **const image, size_t *const image_length, uint32_t *const static_base)
+{
+	flm_elf_section_s section_names;
+	if (!flm_read_section(file, header, header->section_name_index, &section_names))
+		return false;
+
+	size_t length = 0;
+	*static_base = 0;
+	for (size_t index = 0; index < header->section_header_count; ++index) {
+		flm_elf_section_s section;
+		if (!flm_read_section(file, header, index, &section))
+			return false;
+		if (!(section.flags & FLM_ELF_SHF_ALLOC) || index == symbols->device_section)
+			continue;
+		/* Written so it can't wrap, as the section is copied to address within the image we allocate */
+		if (section.size > FLM_IMAGE_MAX || section.address > FLM_IMAGE_MAX - section.size) {
+			DEBUG_WARN("FLM section %zu at 0x%08" PRIx32 "+0x%" PRIx32 " doesn't fit in an image\n", index,
+				section.address, section.size);
+			return false;
+		}
+		length = MAX(length, section.address + section.size);
+		char name[FLM_SYMBOL_NAME_MAX];
+		if (flm_read_string(file, &section_names, section.name, name, sizeof(name)) && !strcmp(name, "PrgData") &&
+			!*static_base)
+			*static_base = section.address;
+	}
+	if (!length)
+		return false;
+
+	/* Leave room on the end for the breakpoint the entry points return to */
+	const size_t return_address = ALIGN(length, 4U);
+	uint8_t *const data = calloc(1, return_address + 4U);
+	if (!data) { /* calloc failed: heap exhaustion */
+		DEBUG_WARN("calloc: failed in %s\n", __func__);
+		return false;
+	}
+	for (size_t index = 0; index < header->section_header_count; ++index) {
+		flm_elf_section_s section;
+		if (!flm_read_section(file, header, index, &section)) {
+			free(data);
+			return false;
+		}
+		if (!(section.flags & FLM_ELF_SHF_ALLOC) || index == symbols->device_section ||
+			section.type != FLM_ELF_SHT_PROGBITS)
+			continue;
+		if (section.size > length || section.address > length - section.size ||
+			!flm_read(file, section.offset, data + section.address, section.size)) {
+			free(data);
+			return false;
+		}
+	}
+	data[return_address] = ARM_THUMB_BREAKPOINT & 0xffU;
+	data[return_address + 1U] = ARM_THUMB_BREAKPOINT >> 8U;
+	*image = data;
+	*image_length = return_address + 4U;
+	return true;
+}
+
+static bool flm_read_device(const flm_file_s *const file, const flm_elf_header_s *const header,
+	const flm_symbols_s *const symbols, flm_device_s *const device, uint32_t *const sectors_offset)
+{
+	flm_elf_section_s section;
+	if (!flm_read_section(file, header, symbols->device_section, &section) ||
+		symbols->device < section.address || symbols->device - section.address >= section.size)
+		return false;
+	const uint32_t offset = section.offset + (symbols->device - section.address);
+	if (!flm_read(file, offset, device, sizeof(*device)))
+		return false;
+	device->name[FLM_DEVICE_NAME_LENGTH - 1U] = '\0';
+	*sectors_offset = offset + sizeof(*device);
+	return true;
+}
+
+/* Find where in target RAM to run the algorithm, defaulting to the largest RAM region the target has */
+static bool flm_pick_ram(target_s *const t, const int argc, const char **const argv, const int ram_arg,
+	target_addr_t *const ram_start, size_t *const ram_length)
+{
+	if (argc > ram_arg + 1) {
+		*ram_start = strtoul(argv[ram_arg], NULL, 0);
+		*ram_length = strtoul(argv[ram_arg + 1], NULL, 0);
+		return true;
+	}
+	*ram_length = 0;
+	for (const target_ram_s *ram = t->ram; ram; ram = ram->next) {
+		if (ram->length > *ram_length) {
+			*ram_start = ram->start;
+			*ram_length = ram->length;
+		}
+	}
+	return *ram_length != 0;
+}
+
+static bool flm_overlaps_flash(target_s *const t, const target_addr_t start, const target_addr_t end)
+{
+	for (const target_flash_s *f = t->flash; f; f = f->next) {
+		if (start < f->start + f->length && f->start < end)
+			return true;
+	}
+	return false;
+}
+
+static flm_flash_s *flm_add_region(target_s *const t, const flm_flash_s *const algorithm,
+	const flm_device_s *const device, const target_addr_t start, const target_addr_t end, const uint32_t sector_size)
+{
+	/* Built-in drivers keep pointers to their own Flash structures, so leave the regions they handle alone */
+	if (flm_overlaps_flash(t, start, end)) {
+		tc_printf(t, "Skipping 0x%08" PRIx32 "-0x%08" PRIx32 ", another driver already handles it\n", start, end);
+		return NULL;
+	}
+	flm_flash_s *const flash = calloc(1, sizeof(*flash) + (algorithm->image.data ? 0U : algorithm->image.length));
+	if (!flash) { /* calloc failed: heap exhaustion */
+		DEBUG_WARN("calloc: failed in %s\n", __func__);
+		return NULL;
+	}
+	*flash = *algorithm;
+
+	target_flash_s *const f = &flash->f;
+	f->start = start;
+	f->length = end - start;
+	f->blocksize = sector_size;
+	f->writesize = device->page_size;
+	/* Let flushes hand over several pages at a time so the next can be uploaded while one is programmed */
+	f->writebufsize = MIN(device->page_size * FLM_WRITE_UNITS, sector_size);
+	f->write_runs = true;
+	f->erase_whole = flash->erase_chip && start == device->address && end == device->address + device->size;
+	f->erased = device->erased_value;
+	f->prepare = flm_flash_prepare;
+	f->erase = flm_flash_erase;
+	/*
+	 * Not erase_lazy: interleaving erases with writes would cost an UnInit and Init pair each way per block,
+	 * as an algorithm is only Init'd for one operation at a time, and would leave the core running EraseSector
+	 * while GDB is free to touch the target.
+	 */
+	f->erase_wait = flm_flash_erase_wait;
+	f->write = flm_flash_write;
+	f->done = flm_flash_done;
+	target_add_flash(t, f);
+	/* Move the region to the end of the list, drivers with monitor commands expect t->flash to be their own */
+	if (f->next) {
+		t->flash = f->next;
+		target_flash_s *last = t->flash;
+		while (last->next)
+			last = last->next;
+		last->next = f;
+		f->next = NULL;
+	}
+	return flash;
+}
+
+static bool flm_is_power_of_two(const uint32_t value)
+{
+	return value && !(value & (value - 1U));
+}
+
+static bool flm_add_regions(target_s *const t, const flm_file_s *const file, flm_flash_s *const algorithm,
+	const flm_device_s *const device, uint32_t sectors_offset, uint8_t *const image)
+{
+	size_t added = 0;
+	flm_sector_s sector;
+	if (!flm_read(file, sectors_offset, &sector, sizeof(sector)))
+		return false;
+	for (size_t index = 0; index < FLM_SECTORS_MAX && sector.size != FLM_SECTOR_END; ++index) {
+		flm_sector_s next;
+		sectors_offset += sizeof(sector);
+		if (!flm_read(file, sectors_offset, &next, sizeof(next)))
+			return false;
+		const uint32_t end = next.size == FLM_SECTOR_END ? device->size : next.offset;
+		if (!flm_is_power_of_two(sector.size) || device->page_size > sector.size || end <= sector.offset) {
+			tc_printf(t, "Unsupported sector layout of %" PRIu32 " bytes at 0x%08" PRIx32 "\n", sector.size,
+				device->address + sector.offset);
+			return added != 0;
+		}
+
+		flm_flash_s *const flash =
+			flm_add_region(t, algorithm, device, device->address + sector.offset, device->address + end, sector.size);
+		/* The first region added carries the image for the rest */
+		if (flash && !algorithm->image.data) {
+			memcpy(flash->image_storage, image, algorithm->image.length);
+			flash->image.data = flash->image_storage;
+			algorithm->image.data = flash->image_storage;
+		}
+		if (flash)
+			++added;
+		sector = next;
+	}
+	return added != 0;
+}
+
+static bool flm_load(target_s *const t, const flm_file_s *const file, const target_addr_t ram_start,
+	const size_t ram_length)
+{
+	flm_elf_header_s header;
+	if (!flm_read(file, 0, &header, sizeof(header)))
+		return false;
+	if (memcmp(header.ident, FLM_ELF_MAGIC, 4) != 0 || header.ident[4] != FLM_ELF_CLASS_32 ||
+		header.ident[5] != FLM_ELF_DATA_LSB || header.machine != FLM_ELF_MACHINE_ARM ||
+		header.section_header_size < sizeof(flm_elf_section_s)) {
+		tc_printf(t, "Not a 32-bit little endian ARM ELF file\n");
+		return false;
+	}
+
+	flm_symbols_s symbols;
+	if (!flm_read_symbols(file, &header, &symbols)) {
+		tc_printf(t, "Flash algorithm entry points or FlashDevice description missing\n");
+		return false;
+	}
+	flm_device_s device;
+	uint32_t sectors_offset = 0;
+	if (!flm_read_device(file, &header, &symbols, &device, &sectors_offset) ||
+		!flm_is_power_of_two(device.page_size)) {
+		tc_printf(t, "Invalid FlashDevice description\n");
+		return false;
+	}
+
+	uint8_t *image = NULL;
+	size_t image_length = 0;
+	uint32_t static_base = 0;
+	if (!flm_read_image(file, &header, &symbols, &image, &image_length, &static_base))
+		return false;
+
+	/* Lay out the image, page buffers and stack in RAM */
+	const uint32_t buffer_size = ALIGN(device.page_size, 8U);
+	const target_addr_t buffers = ALIGN(ram_start + image_length, 8U);
+	const target_addr_t stack = buffers + (2U * buffer_size) + FLM_STACK_SIZE;
+	if (stack - ram_start > ram_length) {
+		tc_printf(t, "Flash algorithm needs %" PRIu32 " bytes of RAM, only %" PRIu32 " available\n",
+			(uint32_t)(stack - ram_start), (uint32_t)ram_length);
+		free(image);
+		return false;
+	}
+
+	flm_flash_s algorithm = {
+		.image = {.address = ram_start, .length = image_length},
+		.device_address = device.address,
+		.init = ram_start + symbols.init,
+		.uninit = ram_start + symbols.uninit,
+		.erase_sector = ram_start + symbols.erase_sector,
+		.erase_chip = symbols.erase_chip ? ram_start + symbols.erase_chip : 0U,
+		.program_page = ram_start + symbols.program_page,
+		.static_base = static_base ? ram_start + static_base : 0U,
+		.return_address = ram_start + image_length - 4U,
+		.stack = stack,
+		.buffer = {buffers, buffers + buffer_size},
+		.program_timeout = device.program_timeout,
+		.erase_timeout = device.erase_timeout,
+	};
+	const bool result = flm_add_regions(t, file, &algorithm, &device, sectors_offset, image);
+	free(image);
+	if (result)
+		tc_printf(t, "Loaded flash algorithm for %s\n", device.name);
+	else
+		tc_printf(t, "No Flash regions added from flash algorithm\n");
+	return result;
+}
+
+#if PC_HOSTED == 1
+bool flm_cmd_load(target_s *t, int argc, const char **argv)
+{
+	if (argc < 2) {
+		tc_printf(t, "usage: monitor load_flm <file> [ram_start ram_length]\n");
+		return false;
+	}
+	target_addr_t ram_start = 0;
+	size_t ram_length = 0;
+	if (!flm_pick_ram(t, argc, argv, 2, &ram_start, &ram_length)) {
+		tc_printf(t, "Target has no RAM to run the algorithm from, please give its address and length\n");
+		return false;
+	}
+
+	FILE *const fd = fopen(argv[1], "rb");
+	if (!fd) {
+		DEBUG_WARN("Error opening %s: %s\n", argv[1], strerror(errno));
+		return false;
+	}
+	fseek(fd, 0, SEEK_END);
+	const long length = ftell(fd);
+	fseek(fd, 0, SEEK_SET);
+	uint8_t *const data = length > 0 ? malloc(length) : NULL;
+	const bool read = data && fread(data, 1, length, fd) == (size_t)length;
+	fclose(fd);
+	if (!read) {
+		DEBUG_WARN("Error reading %s\n", argv[1]);
+		free(data);
+		return false;
+	}
+
+	const flm_file_s file = {.t = t, .data = data, .length = length};
+	const bool result = flm_load(t, &file, ram_start, ram_length);
+	free(data);
+	return result;
+}
+#else
+bool flm_cmd_load(target_s *t, int argc, const char **argv)
+{
+	if (argc < 3) {
+		tc_printf(t, "usage: monitor load_flm <address> <length> [ram_start ram_length]\n");
+		return false;
+	}
+	target_addr_t ram_start = 0;
+	size_t ram_length = 0;
+	if (!flm_pick_ram(t, argc, argv, 3, &ram_start, &ram_length)) {
+		tc_printf(t, "Target has no RAM to run the algorithm from, please give its address and length\n");
+		return false;
+	}
+	/* Everything needed is copied out of the uploaded file here, so it's fine for the image to go over it */
+	const flm_file_s file = {
+		.t = t,
+		.address = strtoul(argv[1], NULL, 0),
+		.length = strtoul(argv[2], NULL, 0),
+	};
+	return flm_load(t, &file, ram_start, ram_length);
+}
+#endif
+
+static bool flm_call(target_flash_s *const f, const uint32_t function, const uint32_t r0, const uint32_t r1,
+	const uint32_t r2, const uint32_t timeout)
+{
+	const flm_flash_s *const flash = (flm_flash_s *)f;
+	const cortexm_call_s call = {
+		.function = function,
+		.args = {r0, r1, r2},
+		.stack = flash->stack,
+		.static_base = flash->static_base,
+		.return_address = flash->return_address,
+		.timeout = timeout,
+	};
+	uint32_t result = 0;
+	if (!cortexm_call(f->t, &call, &result))
+		return false;
+	if (result)
+		DEBUG_WARN("FLM: call to %08" PRIx32 " failed with %" PRIu32 "\n", function, result);
+	return result == 0U;
+}
+
+/* Init the algorithm for an operation, UnInit-ing it from whatever it was last set up for first */
+static bool flm_set_operation(target_flash_s *const f, const uint8_t operation)
+{
+	flm_flash_s *const flash = (flm_flash_s *)f;
+	if (flash->operation == operation)
+		return true;
+	bool result = true;
+	if (flash->operation != FLM_OPERATION_NONE)
+		result = flm_call(f, flash->uninit, flash->operation, 0, 0, FLM_INIT_TIMEOUT_MS);
+	flash->operation = FLM_OPERATION_NONE;
+	if (result && operation != FLM_OPERATION_NONE)
+		result = flm_call(f, flash->init, flash->device_address, 0, operation, FLM_INIT_TIMEOUT_MS);
+	if (result)
+		flash->operation = operation;
+	return result;
+}
+
+static bool flm_flash_prepare(target_flash_s *const f)
+{
+	flm_flash_s *const flash = (flm_flash_s *)f;
+	/* The target may have run over the algorithm since it was last used, so stage it afresh each time */
+	if (!cortexm_call_begin(f->t))
+		return false;
+	target_mem_write(f->t, flash->image.address, flash->image.data, flash->image.length);
+	flash->operation = FLM_OPERATION_NONE;
+	/* A failed prepare gets no done, so close the call session here */
+	if (target_check_error(f->t)) {
+		cortexm_call_end(f->t);
+		return false;
+	}
+	return true;
+}
+
+static bool flm_flash_done(target_flash_s *const f)
+{
+	const bool result = flm_set_operation(f, FLM_OPERATION_NONE);
+	return cortexm_call_end(f->t) && result;
+}
+
+static bool flm_flash_erase(target_flash_s *const f, const target_addr_t addr, const size_t len)
+{
+	flm_flash_s *const flash = (flm_flash_s *)f;
+	if (!flm_set_operation(f, FLM_OPERATION_ERASE))
+		return false;
+
+	flash->erase_call = (cortexm_call_s){
+		.stack = flash->stack,
+		.static_base = flash->static_base,
+		.return_address = flash->return_address,
+	};
+	if (f->erase_whole && addr == f->start && len == f->length) {
+		flash->erase_call.function = flash->erase_chip;
+		flash->erase_call.timeout = flash->erase_timeout * (f->length / f->blocksize);
+		return cortexm_call_start(f->t, &flash->erase_call);
+	}
+	/* Each sector waits out the one before, the last is left running for flm_flash_erase_wait() */
+	flash->erase_call.function = flash->erase_sector;
+	flash->erase_call.timeout = flash->erase_timeout;
+	for (size_t offset = 0; offset < len; offset += f->blocksize) {
+		if (offset && !flm_flash_erase_wait(f))
+			return false;
+		flash->erase_call.args[0] = addr + offset;
+		if (!cortexm_call_start(f->t, &flash->erase_call))
+			return false;
+	}
+	return true;
+}
+
+static bool flm_flash_erase_wait(target_flash_s *const f)
+{
+	const flm_flash_s *const flash = (flm_flash_s *)f;
+	uint32_t result = 0;
+	if (!cortexm_call_wait(f->t, &flash->erase_call, &result))
+		return false;
+	if (result)
+		DEBUG_WARN("FLM: erase at %08" PRIx32 " failed with %" PRIu32 "\n", flash->erase_call.args[0], result);
+	return result == 0U;
+}
+
+/*
+ * Program the run of pages, uploading each next page into the other buffer while ProgramPage
+ * is still busy with the current one.
+ */
+static bool flm_flash_write(
+	target_flash_s *const f, const target_addr_t dest, const void *const src, const size_t len)
+{
+	flm_flash_s *const flash = (flm_flash_s *)f;
+	if (!flm_set_operation(f, FLM_OPERATION_PROGRAM))
+		return false;
+
+	const uint8_t *const data = (const uint8_t *)src;
+	target_mem_write(f->t, flash->buffer[0], data, f->writesize);
+	for (size_t offset = 0, page = 0; offset < len; offset += f->writesize, ++page) {
+		const cortexm_call_s call = {
+			.function = flash->program_page,
+			.args = {dest + offset, f->writesize, flash->buffer[page & 1U]},
+			.stack = flash->stack,
+			.static_base = flash->static_base,
+			.return_address = flash->return_address,
+			.timeout = flash->program_timeout,
+		};
+		if (!cortexm_call_start(f->t, &call))
+			return false;
+		if (offset + f->writesize < len)
+			target_mem_write(f->t, flash->buffer[(page + 1U) & 1U], data + offset + f->writesize, f->writesize);
+		uint32_t result = 0;
+		if (!cortexm_call_wait(f->t, &call, &result))
+			return false;
+		if (result) {
+			DEBUG_WARN(
+				"FLM: ProgramPage at %08" PRIx32 " failed with %" PRIu32 "\n", (uint32_t)(dest + offset), result);
+			return false;
+		}
+	}
+	return true;
+}
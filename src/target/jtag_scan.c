@@ -245,7 +245,7 @@ void jtag_dev_write_ir(const uint8_t dev_index, const uint32_t ir)
 	jtag_proc.jtagtap_tdi_seq(false, ones, device->ir_prescan);
 	jtag_proc.jtagtap_tdi_seq(!device->ir_postscan, (const uint8_t *)&ir, device->ir_len);
 	jtag_proc.jtagtap_tdi_seq(true, ones, device->ir_postscan);
-	jtagtap_return_idle(1);
+	jtagtap_update();
 }
 
 void jtag_dev_shift_dr(const uint8_t dev_index, uint8_t *data_out, const uint8_t *data_in, const size_t clock_cycles)
@@ -259,5 +259,9 @@ void jtag_dev_shift_dr(const uint8_t dev_index, uint8_t *data_out, const uint8_t
 	else
 		jtag_proc.jtagtap_tdi_seq(!device->dr_postscan, (const uint8_t *)data_in, clock_cycles);
 	jtag_proc.jtagtap_tdi_seq(true, ones, device->dr_postscan);
-	jtagtap_return_idle(1);
+	/* Give the access its Run-Test/Idle cycles if the chain wants them, otherwise stop in Update-DR */
+	if (jtag_proc.tap_idle_cycles)
+		jtagtap_return_idle(jtag_proc.tap_idle_cycles);
+	else
+		jtagtap_update();
 }
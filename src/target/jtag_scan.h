@@ -31,6 +31,9 @@ typedef struct jtag_dev {
 	const char *jd_descr;
 	uint32_t jd_idcode;
 	uint32_t current_ir;
+	/* ADIv5 JTAG-DP: the value last written to DP SELECT, if known, so rewrites of it can be skipped */
+	uint32_t dp_select;
+	bool dp_select_valid;
 
 	union {
 		uint8_t jd_dev;
@@ -75,6 +75,8 @@
 #define FTFx_FSTAT_FPVIOL   (1U << 4U)
 #define FTFx_FSTAT_MGSTAT0  (1U << 0U)
 
+#define FTFx_FCNFG_RAMRDY (1U << 1U)
+
 #define FTFx_FSEC_KEYEN_MSK (0b11U << 6U)
 #define FTFx_FSEC_KEYEN     (0b10U << 6U)
 
@@ -84,17 +86,28 @@
 #define FTFx_CMD_PROGRAM_LONGWORD 0x06U
 /* Part of the FTFE module for K64 */
 #define FTFx_CMD_PROGRAM_PHRASE  0x07U
+#define FTFx_CMD_ERASE_BLOCK     0x08U
 #define FTFx_CMD_ERASE_SECTOR    0x09U
+#define FTFx_CMD_PROGRAM_SECTION 0x0bU
 #define FTFx_CMD_CHECK_ERASE_ALL 0x40U
 #define FTFx_CMD_READ_ONCE       0x41U
 #define FTFx_CMD_PROGRAM_ONCE    0x43U
 #define FTFx_CMD_ERASE_ALL       0x44U
 #define FTFx_CMD_BACKDOOR_ACCESS 0x45U
 
+/* Longest a flash command may take, block and mass erases run to seconds */
+#define FTFx_CMD_TIMEOUT 10000U
+
 #define KL_WRITE_LEN 4U
 /* 8 byte phrases need to be written to the k64 flash */
 #define K64_WRITE_LEN 8U
 
+/*
+ * FlexRAM, or the programming acceleration RAM on parts without FlexNVM, holds the data for PROGRAM_SECTION.
+ * Only the lower half of it is used as the section buffer, which every FTFE/FTFC part supports.
+ */
+#define FTFx_FLEXRAM_BASE 0x14000000U
+
 static bool kinetis_cmd_unsafe(target_s *t, int argc, const char **argv);
 
 const command_s kinetis_cmd_list[] = {
@@ -115,19 +128,21 @@ static bool kinetis_cmd_unsafe(target_s *t, int argc, const char **argv)
 static bool kinetis_flash_cmd_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool kinetis_flash_cmd_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
 static bool kinetis_flash_done(target_flash_s *f);
+static bool kinetis_mass_erase(target_s *t);
 
 typedef struct kinetis_flash {
 	target_flash_s f;
 	uint8_t write_len;
+	uint16_t section_len; /* Bytes programmed per PROGRAM_SECTION command, 0 if the part lacks it */
 } kinetis_flash_s;
 
-static void kinetis_add_flash(
+static kinetis_flash_s *kinetis_add_flash(
 	target_s *const t, const uint32_t addr, const size_t length, const size_t erasesize, const size_t write_len)
 {
 	kinetis_flash_s *kf = calloc(1, sizeof(*kf));
 	if (!kf) { /* calloc failed: heap exhaustion */
 		DEBUG_WARN("calloc: failed in %s\n", __func__);
-		return;
+		return NULL;
 	}
 
 	target_flash_s *f = &kf->f;
@@ -140,6 +155,21 @@ static void kinetis_add_flash(
 	f->erased = 0xff;
 	kf->write_len = write_len;
 	target_add_flash(t, f);
+	return kf;
+}
+
+/*
+ * Add a flash block on a FTFE/FTFC part, which can program whole sections staged in FlexRAM
+ * and erase the complete block with a single command.
+ */
+static void kinetis_add_section_flash(target_s *const t, const uint32_t addr, const size_t length,
+	const size_t erasesize, const size_t flexram_len)
+{
+	kinetis_flash_s *const kf = kinetis_add_flash(t, addr, length, erasesize, K64_WRITE_LEN);
+	if (!kf)
+		return;
+	kf->section_len = flexram_len / 2U;
+	kf->f.erase_whole = true;
 }
 
 static void kl_s32k14_setup(
@@ -149,8 +179,8 @@ static void kl_s32k14_setup(
 	target_add_ram(t, sram_l, 0x20000000U - sram_l);
 	target_add_ram(t, 0x20000000, sram_h);
 
-	kinetis_add_flash(t, 0x00000000, flash_size, 0x1000, K64_WRITE_LEN);   /* P-Flash, 4 KB Sectors */
-	kinetis_add_flash(t, 0x10000000, flexmem_size, 0x1000, K64_WRITE_LEN); /* FlexNVM, 4 KB Sectors */
+	kinetis_add_section_flash(t, 0x00000000, flash_size, 0x1000, 0x1000);   /* P-Flash, 4 KB Sectors */
+	kinetis_add_section_flash(t, 0x10000000, flexmem_size, 0x1000, 0x1000); /* FlexNVM, 4 KB Sectors */
 }
 
 bool kinetis_probe(target_s *const t)
@@ -287,8 +317,8 @@ bool kinetis_probe(target_s *const t)
 		t->driver = "K64";
 		target_add_ram(t, 0x1fff0000, 0x10000);
 		target_add_ram(t, 0x20000000, 0x30000);
-		kinetis_add_flash(t, 0, 0x80000, 0x1000, K64_WRITE_LEN);
-		kinetis_add_flash(t, 0x80000, 0x80000, 0x1000, K64_WRITE_LEN);
+		kinetis_add_section_flash(t, 0, 0x80000, 0x1000, 0x1000);
+		kinetis_add_section_flash(t, 0x80000, 0x80000, 0x1000, 0x1000);
 		break;
 	case 0x000U: /* Older K-series */
 		switch (sdid & 0xff0U) {
@@ -352,8 +382,8 @@ bool kinetis_probe(target_s *const t)
 		t->driver = "S32K118";
 		target_add_ram(t, 0x1ffffc00, 0x00000400);                          /* SRAM_L, 1 KB */
 		target_add_ram(t, 0x20000000, 0x00005800);                          /* SRAM_H, 22 KB */
-		kinetis_add_flash(t, 0x00000000, 0x00040000, 0x800, K64_WRITE_LEN); /* P-Flash, 256 KB, 2 KB Sectors */
-		kinetis_add_flash(t, 0x10000000, 0x00008000, 0x800, K64_WRITE_LEN); /* FlexNVM, 32 KB, 2 KB Sectors */
+		kinetis_add_section_flash(t, 0x00000000, 0x00040000, 0x800, 0x800); /* P-Flash, 256 KB, 2 KB Sectors */
+		kinetis_add_section_flash(t, 0x10000000, 0x00008000, 0x800, 0x800); /* FlexNVM, 32 KB, 2 KB Sectors */
 		break;
 	/* Gen1 S32K14X */
 	case 0x142U: /* S32K142 */
@@ -390,6 +420,7 @@ bool kinetis_probe(target_s *const t)
 		return false;
 	}
 	t->unsafe_enabled = false;
+	t->mass_erase = kinetis_mass_erase;
 	target_add_commands(t, kinetis_cmd_list, t->driver);
 	return true;
 }
@@ -401,9 +432,15 @@ static bool kinetis_fccob_cmd(target_s *t, uint8_t cmd, uint32_t addr, const uin
 	/* Clear errors unconditionally, so we can start a new operation */
 	target_mem_write8(t, FTFx_FSTAT, (FTFx_FSTAT_ACCERR | FTFx_FSTAT_FPVIOL));
 
-	/* Wait for CCIF to be high */
+	/* Wait for CCIF to be high, giving up if a previous command never finishes */
+	platform_timeout_s cmd_timeout;
+	platform_timeout_set(&cmd_timeout, FTFx_CMD_TIMEOUT);
 	do {
 		fstat = target_mem_read8(t, FTFx_FSTAT);
+		if (target_check_error(t) || platform_timeout_is_expired(&cmd_timeout)) {
+			DEBUG_WARN("kinetis: flash controller not ready, FSTAT 0x%02x\n", fstat);
+			return false;
+		}
 	} while (!(fstat & FTFx_FSTAT_CCIF));
 
 	/* Write command to FCCOB */
@@ -421,12 +458,20 @@ static bool kinetis_fccob_cmd(target_s *t, uint8_t cmd, uint32_t addr, const uin
 	/* Enable execution by clearing CCIF */
 	target_mem_write8(t, FTFx_FSTAT, FTFx_FSTAT_CCIF);
 
-	/* Wait for execution to complete */
+	/* Wait for execution to complete, block and mass erases can take seconds */
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, 500);
+	platform_timeout_set(&cmd_timeout, FTFx_CMD_TIMEOUT);
 	do {
 		fstat = target_mem_read8(t, FTFx_FSTAT);
 		/* Check ACCERR and FPVIOL are zero in FSTAT */
 		if (fstat & (FTFx_FSTAT_ACCERR | FTFx_FSTAT_FPVIOL))
 			return false;
+		if (target_check_error(t) || platform_timeout_is_expired(&cmd_timeout)) {
+			DEBUG_WARN("kinetis: flash command 0x%02x timed out, FSTAT 0x%02x\n", cmd, fstat);
+			return false;
+		}
+		target_print_progress(&timeout);
 	} while (!(fstat & FTFx_FSTAT_CCIF));
 
 	return true;
@@ -434,6 +479,10 @@ static bool kinetis_fccob_cmd(target_s *t, uint8_t cmd, uint32_t addr, const uin
 
 static bool kinetis_flash_cmd_erase(target_flash_s *const f, target_addr_t addr, size_t len)
 {
+	/* The generic code only hands over the whole block when it was asked to erase all of it */
+	if (f->erase_whole && addr == f->start && len >= f->length)
+		return kinetis_fccob_cmd(f->t, FTFx_CMD_ERASE_BLOCK, addr, NULL, 0);
+
 	while (len) {
 		if (!kinetis_fccob_cmd(f->t, FTFx_CMD_ERASE_SECTOR, addr, NULL, 0))
 			return false;
@@ -448,6 +497,26 @@ static bool kinetis_flash_cmd_erase(target_flash_s *const f, target_addr_t addr,
 	return true;
 }
 
+static bool kinetis_flash_section_write(target_flash_s *const f, target_addr_t dest, const uint8_t *src, size_t len)
+{
+	kinetis_flash_s *const kf = (kinetis_flash_s *)f;
+
+	while (len) {
+		const size_t section_len = MIN(len, kf->section_len);
+		/* One bulk write fills the section buffer, then a single command programs all of it */
+		target_mem_write(f->t, FTFx_FLEXRAM_BASE, src, section_len);
+		/* The phrase or longword count goes in FCCOB4:5, the top half of this word */
+		const uint32_t count = ((section_len + kf->write_len - 1U) / kf->write_len) << 16U;
+		if (!kinetis_fccob_cmd(f->t, FTFx_CMD_PROGRAM_SECTION, dest, &count, 1))
+			return false;
+
+		len -= section_len;
+		dest += section_len;
+		src += section_len;
+	}
+	return true;
+}
+
 static bool kinetis_flash_cmd_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
 {
 	kinetis_flash_s *const kf = (kinetis_flash_s *)f;
@@ -457,6 +526,10 @@ static bool kinetis_flash_cmd_write(target_flash_s *f, target_addr_t dest, const
 		((uint8_t *)src)[FLASH_SECURITY_BYTE_ADDRESS - dest] = FLASH_SECURITY_BYTE_UNSECURED;
 	}
 
+	/* Stage whole sections in FlexRAM when it's usable as RAM, i.e. not partitioned for EEPROM emulation */
+	if (kf->section_len && (target_mem_read8(f->t, FTFx_FCNFG) & FTFx_FCNFG_RAMRDY))
+		return kinetis_flash_section_write(f, dest, src, len);
+
 	/* Determine write command based on the alignment. */
 	uint8_t write_cmd;
 	if (kf->write_len == K64_WRITE_LEN)
@@ -507,6 +580,16 @@ static bool kinetis_flash_done(target_flash_s *const f)
 	return true;
 }
 
+static bool kinetis_mass_erase(target_s *const t)
+{
+	if (!kinetis_fccob_cmd(t, FTFx_CMD_ERASE_ALL, 0, NULL, 0))
+		return false;
+
+	/* ERASE_ALL_BLOCKS leaves the security byte erased, which would secure the part at the next reset */
+	target_flash_s *const f = target_flash_for_addr(t, FLASH_SECURITY_BYTE_ADDRESS);
+	return !f || kinetis_flash_done(f);
+}
+
 /*
  * Kinetis recovery mode using the MDM-AP
  *
@@ -74,6 +74,8 @@ static const char *const iap_error[] = {
 #endif
 
 static bool lpc_flash_write(target_flash_s *tf, target_addr_t dest, const void *src, size_t len);
+static bool lpc_flash_prepare(target_flash_s *f);
+static bool lpc_flash_done(target_flash_s *f);
 
 lpc_flash_s *lpc_add_flash(target_s *t, target_addr_t addr, size_t length)
 {
@@ -90,11 +92,24 @@ lpc_flash_s *lpc_add_flash(target_s *t, target_addr_t addr, size_t length)
 	f->length = length;
 	f->erase = lpc_flash_erase;
 	f->write = lpc_flash_write;
+	f->prepare = lpc_flash_prepare;
+	f->done = lpc_flash_done;
 	f->erased = 0xff;
 	target_add_flash(t, f);
 	return lf;
 }
 
+/* The core's registers are saved once per flash operation rather than around every IAP call */
+static bool lpc_flash_prepare(target_flash_s *f)
+{
+	return cortexm_call_begin(f->t);
+}
+
+static bool lpc_flash_done(target_flash_s *f)
+{
+	return cortexm_call_end(f->t);
+}
+
 static uint8_t lpc_sector_for_addr(lpc_flash_s *f, uint32_t addr)
 {
 	return f->base_sector + (addr - f->f.start) / f->f.blocksize;
@@ -124,10 +139,6 @@ iap_status_e lpc_iap_call(lpc_flash_s *f, void *result, iap_cmd_e cmd, ...)
 	flash_param_s backup_param;
 	target_mem_read(t, &backup_param, f->iap_ram, sizeof(backup_param));
 
-	/* save registers to restore after IAP call */
-	uint32_t backup_regs[t->regs_size / sizeof(uint32_t)];
-	target_regs_read(t, backup_regs);
-
 	/* Fill out the remainder of the parameters */
 	va_list ap;
 	va_start(ap, cmd);
@@ -138,32 +149,24 @@ iap_status_e lpc_iap_call(lpc_flash_s *f, void *result, iap_cmd_e cmd, ...)
 	/* Copy the structure to RAM */
 	target_mem_write(t, f->iap_ram, &param, sizeof(param));
 
-	/* Set up for the call to the IAP ROM */
-	uint32_t regs[t->regs_size / sizeof(uint32_t)];
-	target_regs_read(t, regs);
-	regs[0] = f->iap_ram + offsetof(flash_param_s, command);
-	regs[1] = f->iap_ram + offsetof(flash_param_s, status);
-	regs[REG_MSP] = f->iap_msp;
-	regs[REG_LR] = f->iap_ram | 1U;
-	regs[REG_PC] = f->iap_entry;
-	target_regs_write(t, regs);
-
-	platform_timeout_s timeout;
-	platform_timeout_set(&timeout, 500);
-	const bool full_erase = cmd == IAP_CMD_ERASE && lpc_is_full_erase(f, param.words[0], param.words[1]);
-	/* Start the target and wait for it to halt again */
-	target_halt_resume(t, false);
-	while (!target_halt_poll(t, NULL)) {
-		if (full_erase)
-			target_print_progress(&timeout);
-	}
+	/* Set up for the call to the IAP ROM, returning to the breakpoint at the start of the structure */
+	const cortexm_call_s call = {
+		.function = f->iap_entry,
+		.args = {f->iap_ram + offsetof(flash_param_s, command), f->iap_ram + offsetof(flash_param_s, status)},
+		.stack = f->iap_msp,
+		.return_address = f->iap_ram,
+		.show_progress = cmd == IAP_CMD_ERASE && lpc_is_full_erase(f, param.words[0], param.words[1]),
+	};
+	const bool called = cortexm_call(t, &call, NULL);
 
 	/* Copy back just the parameters structure */
 	target_mem_read(t, &param, f->iap_ram, sizeof(param));
+	/* If the IAP didn't make it back, don't trust whatever it left in the status */
+	if (!called)
+		param.status = 0xdeadbeef;
 
-	/* Restore the original data in RAM and registers */
+	/* Restore the original data in RAM */
 	target_mem_write(t, f->iap_ram, &backup_param, sizeof(param));
-	target_regs_write(t, backup_regs);
 
 	/* If the user expected a result, set the result (16 bytes). */
 	if (result != NULL)
@@ -111,7 +111,9 @@ static bool msp432_flash_erase(target_flash_s *f, target_addr_t addr, size_t len
 static bool msp432_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
 
 /* Call a function in the MSP432 ROM (or anywhere else...)*/
-static void msp432_call_rom(target_s *t, uint32_t address, uint32_t *regs);
+static uint32_t msp432_call_rom(target_s *t, uint32_t address, uint32_t r0, uint32_t r1, uint32_t r2);
+static bool msp432_flash_prepare(target_flash_s *f);
+static bool msp432_flash_done(target_flash_s *f);
 
 /* Protect or unprotect the sector containing address */
 static inline uint32_t msp432_sector_unprotect(msp432_flash_s *mf, target_addr_t addr)
@@ -154,6 +156,8 @@ static void msp432_add_flash(target_s *t, uint32_t addr, size_t length, target_a
 	f->blocksize = SECTOR_SIZE;
 	f->erase = msp432_flash_erase;
 	f->write = msp432_flash_write;
+	f->prepare = msp432_flash_prepare;
+	f->done = msp432_flash_done;
 	f->writesize = SRAM_WRITE_BUF_SIZE;
 	f->erased = 0xff;
 	target_add_flash(t, f);
@@ -232,22 +236,17 @@ static bool msp432_sector_erase(target_flash_s *f, target_addr_t addr)
 	uint32_t old_prot = msp432_sector_unprotect(mf, addr);
 	DEBUG_WARN("Flash protect: 0x%08" PRIX32 "\n", target_mem_read32(t, mf->flash_protect_register));
 
-	/* Prepare input data */
-	uint32_t regs[t->regs_size / sizeof(uint32_t)]; // Use of VLA
-	target_regs_read(t, regs);
-	regs[0] = addr; // Address of sector to erase in R0
-
 	DEBUG_INFO("Erasing sector at 0x%08" PRIX32 "\n", addr);
 
-	/* Call ROM */
-	msp432_call_rom(t, mf->flash_erase_sector_fn, regs);
+	/* Call ROM with the address of the sector to erase */
+	const uint32_t result = msp432_call_rom(t, mf->flash_erase_sector_fn, addr, 0, 0);
 
 	// Result value in R0 is true for success
-	DEBUG_INFO("ROM return value: %" PRIu32 "\n", regs[0]);
+	DEBUG_INFO("ROM return value: %" PRIu32 "\n", result);
 
 	/* Restore original protection */
 	target_mem_write32(t, mf->flash_protect_register, old_prot);
-	return regs[0] != 0;
+	return result != 0;
 }
 
 /* Erase from addr for len bytes */
@@ -282,24 +281,28 @@ static bool msp432_flash_write(target_flash_s *f, target_addr_t dest, const void
 
 	DEBUG_WARN("Flash protect: 0x%08" PRIX32 "\n", target_mem_read32(t, mf->flash_protect_register));
 
-	/* Prepare input data */
-	uint32_t regs[t->regs_size / sizeof(uint32_t)]; // Use of VLA
-	target_regs_read(t, regs);
-	regs[0] = SRAM_WRITE_BUFFER; // Address of buffer to be flashed in R0
-	regs[1] = dest;              // Flash address to be write to in R1
-	regs[2] = len;               // Size of buffer to be flashed in R2
-
 	DEBUG_INFO("Writing 0x%04" PRIX32 " bytes at 0x%08zu\n", dest, len);
-	/* Call ROM */
-	msp432_call_rom(t, mf->flash_program_fn, regs);
+	/* Call ROM with the buffer to be flashed, the flash address to write to and the size of the buffer */
+	const uint32_t result = msp432_call_rom(t, mf->flash_program_fn, SRAM_WRITE_BUFFER, dest, len);
 
 	/* Restore original protection */
 	target_mem_write32(t, mf->flash_protect_register, old_prot);
 
-	DEBUG_INFO("ROM return value: %" PRIu32 "\n", regs[0]);
+	DEBUG_INFO("ROM return value: %" PRIu32 "\n", result);
 
 	// Result value in R0 is true for success
-	return regs[0] != 0;
+	return result != 0;
+}
+
+/* Keep the core's registers aside for the whole flash operation rather than around every ROM call */
+static bool msp432_flash_prepare(target_flash_s *f)
+{
+	return cortexm_call_begin(f->t);
+}
+
+static bool msp432_flash_done(target_flash_s *f)
+{
+	return cortexm_call_end(f->t);
 }
 
 /* Optional commands handlers */
@@ -342,8 +345,8 @@ static bool msp432_cmd_sector_erase(target_s *t, int argc, const char **argv)
 	return false;
 }
 
-/* MSP432 ROM routine invocation */
-static void msp432_call_rom(target_s *t, uint32_t address, uint32_t *regs)
+/* MSP432 ROM routine invocation, returns the routine's result or 0 if the call failed */
+static uint32_t msp432_call_rom(target_s *t, uint32_t address, uint32_t r0, uint32_t r1, uint32_t r2)
 {
 	/* Kill watchdog */
 	target_mem_write16(t, WDT_A_WTDCTL, WDT_A_HOLD);
@@ -351,17 +354,14 @@ static void msp432_call_rom(target_s *t, uint32_t address, uint32_t *regs)
 	/* Breakpoint at the beginning of CODE SRAM alias area */
 	target_mem_write16(t, SRAM_CODE_BASE, ARM_THUMB_BREAKPOINT);
 
-	/* Prepare registers */
-	regs[REG_MSP] = SRAM_STACK_PTR;     /* Stack space */
-	regs[REG_LR] = SRAM_CODE_BASE | 1U; /* Return to beginning of SRAM CODE alias */
-	regs[REG_PC] = address;             /* Start at given address */
-	target_regs_write(t, regs);
-
-	/* Start the target and wait for it to halt again, which calls the routine setup above */
-	target_halt_resume(t, false);
-	while (!target_halt_poll(t, NULL))
-		continue;
-
-	// Read registers to get result
-	target_regs_read(t, regs);
+	const cortexm_call_s call = {
+		.function = address,
+		.args = {r0, r1, r2},
+		.stack = SRAM_STACK_PTR,           /* Stack space */
+		.return_address = SRAM_CODE_BASE, /* Return to beginning of SRAM CODE alias */
+	};
+	uint32_t result = 0;
+	if (!cortexm_call(t, &call, &result))
+		return 0;
+	return result;
 }
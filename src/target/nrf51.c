@@ -72,6 +72,8 @@ const command_s nrf51_read_cmd_list[] = {
 #define NRF51_NVMC_CONFIG_WEN 0x1U // Write enable
 #define NRF51_NVMC_CONFIG_EEN 0x2U // Erase enable
 
+#define NRF51_NVMC_READY_READY 0x1U // NVMC is ready
+
 /* Factory Information Configuration Registers (FICR) */
 #define NRF51_FICR                 0x10000000U
 #define NRF51_FICR_CODEPAGESIZE    (NRF51_FICR + 0x010U)
@@ -167,13 +169,14 @@ bool nrf51_probe(target_s *t)
 static bool nrf51_wait_ready(target_s *const t, platform_timeout_s *const timeout)
 {
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0) {
+	while (
+		!target_mem_poll32(t, NRF51_NVMC_READY, NRF51_NVMC_READY_READY, NRF51_NVMC_READY_READY, TARGET_POLL_SLICE)) {
 		if (target_check_error(t))
 			return false;
 		if (timeout)
 			target_print_progress(timeout);
 	}
-	return true;
+	return !target_check_error(t);
 }
 
 static bool nrf51_flash_prepare(target_flash_s *f)
@@ -38,6 +38,10 @@
 #include "cortexm.h"
 #include "adiv5.h"
 
+static const uint16_t renesas_rv40_program_stub[] = {
+#include "flashstub/renesas_rv40.stub"
+};
+
 #define RENESAS_PARTID_RA2A1 0x01b0U
 #define RENESAS_PARTID_RA4M2 0x0340U
 #define RENESAS_PARTID_RA4M3 0x0310U
@@ -226,6 +230,15 @@ typedef enum {
 #define RV40_CF_WRITE_SIZE         (0x80U)
 #define RV40_DF_WRITE_SIZE         (0x4U)
 
+/*
+ * Code flash is programmed by a stub running from SRAM, fed from two buffers so the next chunk is uploaded while
+ * the previous one is being programmed. The RA6T1 only has SRAMHS, the other RV40 parts all have SRAM at 0x20000000
+ */
+#define RV40_SRAM_BASE        UINT32_C(0x20000000)
+#define RV40_SRAMHS_BASE      UINT32_C(0x1ffe0000)
+#define RV40_CF_WRITEBUF_SIZE (RV40_CF_WRITE_SIZE * 32U)
+#define RV40_STUB_CHUNK_SIZE  (RV40_CF_WRITEBUF_SIZE / 2U)
+
 /* RV40 Flash Commands */
 #define RV40_CMD               UINT32_C(0x407e0000)
 #define RV40_CMD_PROGRAM       0xe8U
@@ -438,7 +451,7 @@ static bool renesas_rv40_error_check(target_s *t, uint32_t error_bits)
 {
 	bool error = false;
 
-	uint8_t fstatr = target_mem_read32(t, RV40_FSTATR);
+	const uint32_t fstatr = target_mem_read32(t, RV40_FSTATR);
 
 	/* see "Recovery from the Command-Locked State": Section 47.9.3.6 of the RA6M4 manual R01UH0890EJ0100.*/
 	if (target_mem_read8(t, RV40_FASTAT) & RV40_FASTAT_CMDLK) {
@@ -552,15 +565,54 @@ static bool renesas_rv40_flash_erase(target_flash_s *f, target_addr_t addr, size
 	return true;
 }
 
+static bool renesas_rv40_cf_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
+{
+	target_s *t = f->t;
+	const renesas_priv_s *const priv_storage = (renesas_priv_s *)t->target_storage;
+	const uint8_t *data = (const uint8_t *)src;
+
+	const target_addr_t stub_base = priv_storage->series == PNR_SERIES_RA6T1 ? RV40_SRAMHS_BASE : RV40_SRAM_BASE;
+	const target_addr_t buffer_base = ALIGN(stub_base + sizeof(renesas_rv40_program_stub), 4U);
+	const target_addr_t buffers[2] = {buffer_base, buffer_base + RV40_STUB_CHUNK_SIZE};
+
+	target_mem_write(t, stub_base, renesas_rv40_program_stub, sizeof(renesas_rv40_program_stub));
+	size_t chunk = MIN(len, RV40_STUB_CHUNK_SIZE);
+	target_mem_write(t, buffers[0], data, chunk);
+	bool result = !target_check_error(t);
+
+	for (size_t buffer = 0U; result && len; buffer ^= 1U) {
+		if (!cortexm_start_stub(t, stub_base, dest, buffers[buffer], chunk, RV40_FSTATR)) {
+			result = false;
+			break;
+		}
+		dest += chunk;
+		data += chunk;
+		len -= chunk;
+
+		/* Stage the next chunk in the other buffer while the stub works through this one */
+		const size_t next_chunk = MIN(len, RV40_STUB_CHUNK_SIZE);
+		if (next_chunk)
+			target_mem_write(t, buffers[buffer ^ 1U], data, next_chunk);
+
+		result = cortexm_wait_stub(t) == 0 && !target_check_error(t);
+		chunk = next_chunk;
+	}
+
+	/* The error check also recovers the FACI if the stub stopped part way through a command */
+	return !renesas_rv40_error_check(t, RV40_FSTATR_PRGERR | RV40_FSTATR_ILGLERR) && result;
+}
+
 static bool renesas_rv40_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
 {
 	target_s *t = f->t;
 
 	/* code flash or data flash operation */
 	const bool code_flash = dest < RENESAS_CF_END;
+	if (code_flash)
+		return renesas_rv40_cf_write(f, dest, src, len);
 
-	/* write size for code flash / data flash */
-	const uint8_t write_size = code_flash ? RV40_CF_WRITE_SIZE : RV40_DF_WRITE_SIZE;
+	/* write size for data flash */
+	const uint8_t write_size = RV40_DF_WRITE_SIZE;
 
 	while (len) {
 		/* set block start address */
@@ -622,8 +674,9 @@ static void renesas_add_rv40_flash(target_s *t, target_addr_t addr, size_t lengt
 
 	if (code_flash) {
 		f->blocksize = RV40_CF_REGION1_BLOCK_SIZE;
-		f->writebufsize = RV40_CF_WRITE_SIZE * 8U;
+		f->writebufsize = RV40_CF_WRITEBUF_SIZE;
 		f->writesize = RV40_CF_WRITE_SIZE;
+		f->write_runs = true;
 	} else {
 		f->blocksize = RV40_DF_BLOCK_SIZE;
 		f->writebufsize = RV40_DF_BLOCK_SIZE * 8U;
@@ -117,6 +117,7 @@
 #define RP_SSI_XIP_SPI_CTRL0_ADDRESS_LENGTH(x) (((x)*2U) << 2U)
 #define RP_SSI_XIP_SPI_CTRL0_INSTR_LENGTH_8b   (2U << 8U)
 #define RP_SSI_XIP_SPI_CTRL0_WAIT_CYCLES(x)    (((x)*8U) << 11U)
+#define RP_SSI_XIP_SPI_CTRL0_WAIT_CLOCKS(x)    ((x) << 11U)
 #define RP_SSI_XIP_SPI_CTRL0_XIP_CMD_SHIFT     24U
 #define RP_SSI_XIP_SPI_CTRL0_XIP_CMD(x)        ((x) << RP_SSI_XIP_SPI_CTRL0_XIP_CMD_SHIFT)
 #define RP_SSI_XIP_SPI_CTRL0_TRANS_1C1A        (0U << 0U)
@@ -152,13 +153,11 @@
 #define BOOTROM_FUNC_TABLE_ADDR      0x00000014U
 #define BOOTROM_FUNC_TABLE_TAG(x, y) ((uint8_t)(x) | ((uint8_t)(y) << 8U))
 
-#define FLASHSIZE_4K_SECTOR      (4U * 1024U)
-#define FLASHSIZE_32K_BLOCK      (32U * 1024U)
-#define FLASHSIZE_64K_BLOCK      (64U * 1024U)
-#define FLASHSIZE_32K_BLOCK_MASK ~(FLASHSIZE_32K_BLOCK - 1U)
-#define FLASHSIZE_64K_BLOCK_MASK ~(FLASHSIZE_64K_BLOCK - 1U)
-#define MAX_FLASH                (16U * 1024U * 1024U)
-#define MAX_WRITE_CHUNK          0x1000U
+#define FLASHSIZE_4K_SECTOR (4U * 1024U)
+#define FLASHSIZE_32K_BLOCK (32U * 1024U)
+#define FLASHSIZE_64K_BLOCK (64U * 1024U)
+#define MAX_FLASH           (16U * 1024U * 1024U)
+#define MAX_WRITE_CHUNK     0x1000U
 
 #define RP_SPI_OPCODE(x)            (x)
 #define RP_SPI_OPCODE_MASK          0x00ffU
@@ -196,13 +195,17 @@ typedef struct rp_priv {
 	uint16_t rom_reset_usb_boot;
 	bool is_prepared;
 	bool is_monitor;
-	uint32_t regs[0x20]; /* Register playground*/
+	uint32_t regs[4]; /* Arguments for the next ROM call */
 } rp_priv_s;
 
 typedef struct rp_flash {
 	target_flash_s f;
 	uint32_t page_size;
 	uint8_t sector_erase_opcode;
+	uint8_t erase_types_count;
+	spi_erase_type_s erase_types[SPI_FLASH_ERASE_TYPES];
+	spi_read_mode_id_e read_mode_id;
+	spi_read_mode_s read_mode;
 } rp_flash_s;
 
 static bool rp_cmd_erase_sector(target_s *t, int argc, const char **argv);
@@ -228,7 +231,7 @@ static bool rp_mass_erase(target_s *t);
 static bool rp_flash_in_por_state(target_s *t);
 // Our own implementation of bootloader functions for handling flash chip
 static void rp_flash_exit_xip(target_s *t);
-static void rp_flash_enter_xip(target_s *t);
+static void rp_flash_enter_xip(target_s *t, const rp_flash_s *flash);
 static void rp_flash_connect_internal(target_s *t);
 static void rp_flash_flush_cache(target_s *t);
 
@@ -253,18 +256,44 @@ static void rp_add_flash(target_s *t)
 
 	spi_parameters_s spi_parameters;
 	if (!sfdp_read_parameters(t, &spi_parameters, rp_spi_read_sfdp)) {
-		/* SFDP readout failed, so make some assumptions and hope for the best. */
+		/* SFDP readout failed, so make some assumptions (those of the W25Q16JV) and hope for the best. */
+		memset(&spi_parameters, 0, sizeof(spi_parameters));
 		spi_parameters.page_size = 256U;
-		spi_parameters.sector_size = 4096U;
+		spi_parameters.sector_size = FLASHSIZE_4K_SECTOR;
 		spi_parameters.capacity = rp_get_flash_length(t);
 		spi_parameters.sector_erase_opcode = SPI_FLASH_CMD_SECTOR_ERASE;
+		spi_parameters.erase_types[0] = (spi_erase_type_s){
+			.size = FLASHSIZE_4K_SECTOR, .typical_ms = 45U, .max_ms = 400U, .opcode = SPI_FLASH_CMD_SECTOR_ERASE};
+		spi_parameters.erase_types[1] = (spi_erase_type_s){
+			.size = FLASHSIZE_32K_BLOCK, .typical_ms = 120U, .max_ms = 1600U, .opcode = FLASHCMD_BLOCK32K_ERASE};
+		spi_parameters.erase_types[2] = (spi_erase_type_s){
+			.size = FLASHSIZE_64K_BLOCK, .typical_ms = 150U, .max_ms = 2000U, .opcode = FLASHCMD_BLOCK64K_ERASE};
+		spi_parameters.erase_types_count = 3U;
+		spi_parameters.read_modes[SPI_READ_1_1_1] = (spi_read_mode_s){.supported = true, .opcode = 0x03U};
+	}
+
+	flash->page_size = spi_parameters.page_size;
+	flash->sector_erase_opcode = spi_parameters.sector_erase_opcode;
+	flash->erase_types_count = spi_parameters.erase_types_count;
+	memcpy(flash->erase_types, spi_parameters.erase_types, sizeof(flash->erase_types));
+	/*
+	 * The boot ROM only knows the 03h read, so pick the fastest read the SSI can be set up for without touching
+	 * the Flash's configuration - that rules out the quad modes as they need the QE bit setting.
+	 * The dual I/O mode sends its mode bits with the address, which the SSI can't do in XIP mode either.
+	 */
+	flash->read_mode_id = sfdp_fastest_read_mode(&spi_parameters, SPI_READ_MODE_MASK(SPI_READ_1_1_2));
+	flash->read_mode = spi_parameters.read_modes[flash->read_mode_id];
+	if (flash->read_mode.mode_clocks) {
+		flash->read_mode_id = SPI_READ_1_1_1;
+		flash->read_mode = spi_parameters.read_modes[SPI_READ_1_1_1];
 	}
 
 	if (por_state)
 		rp_flash_flush_cache(t);
-	rp_flash_enter_xip(t);
+	rp_flash_enter_xip(t, flash);
 
-	DEBUG_INFO("Flash size: %" PRIu32 "MiB\n", (uint32_t)spi_parameters.capacity / (1024U * 1024U));
+	DEBUG_INFO("Flash size: %" PRIu32 "MiB, read opcode %02x\n", (uint32_t)spi_parameters.capacity / (1024U * 1024U),
+		flash->read_mode.opcode);
 
 	target_flash_s *const f = &flash->f;
 	f->start = RP_XIP_FLASH_BASE;
@@ -275,9 +304,6 @@ static void rp_add_flash(target_s *t)
 	f->writesize = MAX_WRITE_CHUNK; /* Max buffer size used otherwise */
 	f->erased = 0xffU;
 	target_add_flash(t, f);
-
-	flash->page_size = spi_parameters.page_size;
-	flash->sector_erase_opcode = spi_parameters.sector_erase_opcode;
 }
 
 bool rp_probe(target_s *t)
@@ -383,6 +409,20 @@ static bool rp_read_rom_func_table(target_s *const t)
 	return check == 9;
 }
 
+#define RP_ROM_CALL_STACK 0x20042000U
+
+static cortexm_call_s rp_rom_call_setup(const rp_priv_s *ps, uint32_t timeout)
+{
+	/* ROM functions return to the bkpt at the end of the ROM's debug trampoline */
+	const cortexm_call_s call = {
+		.stack = RP_ROM_CALL_STACK,
+		.return_address = ps->rom_debug_trampoline_end,
+		.timeout = timeout,
+		.show_progress = ps->is_monitor,
+	};
+	return call;
+}
+
 /* RP ROM functions calls
  *
  * timeout == 0: Do not wait for poll, use for rom_reset_usb_boot()
@@ -391,36 +431,30 @@ static bool rp_read_rom_func_table(target_s *const t)
 static bool rp_rom_call(target_s *t, uint32_t *regs, uint32_t cmd, uint32_t timeout)
 {
 	rp_priv_s *ps = (rp_priv_s *)t->target_storage;
-	regs[7] = cmd;
-	regs[REG_LR] = ps->rom_debug_trampoline_end;
-	regs[REG_PC] = ps->rom_debug_trampoline_begin;
-	regs[REG_MSP] = 0x20042000;
-	regs[REG_XPSR] = CORTEXM_XPSR_THUMB;
-	uint32_t dbg_regs[t->regs_size / sizeof(uint32_t)];
-	target_regs_write(t, regs);
-	/* start the target and wait for it to halt again */
-	target_halt_resume(t, false);
-	if (!timeout)
-		return false;
+	cortexm_call_s call = rp_rom_call_setup(ps, timeout);
+	call.function = cmd;
+	memcpy(call.args, regs, sizeof(call.args));
 	DEBUG_INFO("Call cmd %04" PRIx32 "\n", cmd);
-	platform_timeout_s operation_timeout;
-	platform_timeout_set(&operation_timeout, timeout);
-	platform_timeout_s wait_timeout;
-	platform_timeout_set(&wait_timeout, 500);
-	while (!target_halt_poll(t, NULL)) {
-		if (ps->is_monitor)
-			target_print_progress(&wait_timeout);
-		if (platform_timeout_is_expired(&operation_timeout)) {
-			DEBUG_WARN("RP run timeout %" PRIu32 "ms reached: ", timeout);
-			break;
-		}
-	}
-	/* Debug */
-	target_regs_read(t, dbg_regs);
-	const bool result = (dbg_regs[REG_PC] & ~1U) == (ps->rom_debug_trampoline_end & ~1U);
-	if (!result) {
-		DEBUG_WARN("rp_rom_call cmd %04" PRIx32 " failed, PC %08" PRIx32 "\n", cmd, dbg_regs[REG_PC]);
+	if (!timeout) {
+		cortexm_call_start(t, &call);
+		return false;
 	}
+	const bool result = cortexm_call(t, &call, NULL);
+	if (!result)
+		DEBUG_WARN("rp_rom_call cmd %04" PRIx32 " failed\n", cmd);
+	return result;
+}
+
+/* Run several ROM calls with one resume, staging the trampoline and call table in the write buffer */
+static bool rp_rom_call_batch(
+	target_s *t, cortexm_call_entry_s *calls, size_t count, uint32_t timeout, const bool show_progress)
+{
+	rp_priv_s *ps = (rp_priv_s *)t->target_storage;
+	cortexm_call_s call = rp_rom_call_setup(ps, timeout);
+	call.show_progress |= show_progress;
+	const bool result = cortexm_call_batch(t, &call, RP_SRAM_BASE, calls, count, false);
+	if (!result)
+		DEBUG_WARN("rp_rom_call_batch of %zu calls failed\n", count);
 	return result;
 }
 
@@ -430,10 +464,15 @@ static bool rp_flash_prepare(target_s *t)
 	bool result = true; /* catch false returns with &= */
 	if (!ps->is_prepared) {
 		DEBUG_INFO("rp_flash_prepare\n");
-		/* connect*/
-		result &= rp_rom_call(t, ps->regs, ps->rom_connect_internal_flash, 100);
-		/* exit_xip */
-		result &= rp_rom_call(t, ps->regs, ps->rom_flash_exit_xip, 100);
+		/* Registers are kept aside until rp_flash_resume() rather than around every ROM call */
+		if (!cortexm_call_begin(t))
+			return false;
+		/* connect, then exit_xip */
+		cortexm_call_entry_s calls[] = {
+			{.function = ps->rom_connect_internal_flash},
+			{.function = ps->rom_flash_exit_xip},
+		};
+		result &= rp_rom_call_batch(t, calls, ARRAY_LENGTH(calls), 200, false);
 		ps->is_prepared = true;
 	}
 	return result;
@@ -445,22 +484,32 @@ static bool rp_flash_resume(target_s *t)
 	bool result = true; /* catch false returns with &= */
 	if (ps->is_prepared) {
 		DEBUG_INFO("rp_flash_resume\n");
-		/* flush */
-		result &= rp_rom_call(t, ps->regs, ps->rom_flash_flush_cache, 100);
-		/* enter_cmd_xip */
-		result &= rp_rom_call(t, ps->regs, ps->rom_flash_enter_xip, 100);
+		/* flush, then enter_cmd_xip */
+		cortexm_call_entry_s calls[] = {
+			{.function = ps->rom_flash_flush_cache},
+			{.function = ps->rom_flash_enter_xip},
+		};
+		result &= rp_rom_call_batch(t, calls, ARRAY_LENGTH(calls), 200, false);
+		/* The ROM leaves the SSI doing 03h reads, switch to something faster if the Flash has it */
+		const rp_flash_s *const flash = (const rp_flash_s *)t->flash;
+		if (flash && flash->read_mode_id != SPI_READ_1_1_1)
+			rp_flash_enter_xip(t, flash);
+		result &= cortexm_call_end(t);
 		ps->is_prepared = false;
 	}
 	return result;
 }
 
 /*
- * 4k sector erase	45/  400 ms
- * 32k block erase	120/ 1600 ms
- * 64k block erase	150/ 2000 ms
- * chip erase		5000/25000 ms
- * page program		0.4/  3 ms
+ * Erase timeouts for when the Flash's SFDP doesn't give any timings,
+ * based on the W25Q16JV's maximums: 4k sector 400 ms, 64k block 2000 ms
  */
+static uint32_t rp_flash_erase_timeout(const spi_erase_type_s *const erase_type, const uint32_t erases)
+{
+	const uint32_t max_ms = erase_type->max_ms ? erase_type->max_ms : 400U + (erase_type->size / 40U);
+	return erases * max_ms;
+}
+
 static bool rp_flash_erase(target_flash_s *f, target_addr_t addr, size_t len)
 {
 	DEBUG_INFO("Erase addr 0x%08" PRIx32 " len 0x%" PRIx32 "\n", addr, (uint32_t)len);
@@ -478,50 +527,56 @@ static bool rp_flash_erase(target_flash_s *f, target_addr_t addr, size_t len)
 	len = ALIGN(len, f->blocksize);
 	len = MIN(len, f->length - addr);
 	rp_priv_s *ps = (rp_priv_s *)t->target_storage;
-	const bool full_erase = addr == f->start && len == f->length;
-	platform_timeout_s timeout;
-	platform_timeout_set(&timeout, 500);
+	rp_flash_s *flash = (rp_flash_s *)f;
+	const bool full_erase = addr == 0U && len == f->length;
+	const spi_erase_type_s sector = {.size = f->blocksize, .opcode = flash->sector_erase_opcode};
+	const spi_erase_type_s *sector_type = &sector;
+	for (size_t i = 0; i < flash->erase_types_count; ++i) {
+		if (flash->erase_types[i].size == f->blocksize && flash->erase_types[i].opcode == flash->sector_erase_opcode)
+			sector_type = &flash->erase_types[i];
+	}
 
-	/* erase */
-	bool result = false;
-	while (len) {
-		if (len >= FLASHSIZE_64K_BLOCK) {
-			const uint32_t chunk = len & FLASHSIZE_64K_BLOCK_MASK;
-			ps->regs[0] = addr;
-			ps->regs[1] = chunk;
-			ps->regs[2] = FLASHSIZE_64K_BLOCK;
-			ps->regs[3] = FLASHCMD_BLOCK64K_ERASE;
-			DEBUG_WARN("64k_ERASE addr 0x%08" PRIx32 " len 0x%" PRIx32 "\n", addr, chunk);
-			result = rp_rom_call(t, ps->regs, ps->rom_flash_range_erase, 25100);
-			len -= chunk;
-			addr += chunk;
-		} else if (len >= FLASHSIZE_32K_BLOCK) {
-			const uint32_t chunk = len & FLASHSIZE_32K_BLOCK_MASK;
-			ps->regs[0] = addr;
-			ps->regs[1] = chunk;
-			ps->regs[2] = FLASHSIZE_32K_BLOCK;
-			ps->regs[3] = FLASHCMD_BLOCK32K_ERASE;
-			DEBUG_WARN("32k_ERASE addr 0x%08" PRIx32 " len 0x%" PRIx32 "\n", addr, chunk);
-			result = rp_rom_call(t, ps->regs, ps->rom_flash_range_erase, 1700);
-			len -= chunk;
-			addr += chunk;
-		} else {
-			rp_flash_s *flash = (rp_flash_s *)f;
-			ps->regs[0] = addr;
-			ps->regs[1] = len;
-			ps->regs[2] = f->blocksize;
-			ps->regs[3] = flash->sector_erase_opcode;
-			DEBUG_WARN("Sector_ERASE addr 0x%08" PRIx32 " len 0x%" PRIx32 "\n", addr, (uint32_t)len);
-			result = rp_rom_call(t, ps->regs, ps->rom_flash_range_erase, 410);
-			len = 0;
-		}
-		if (!result) {
-			DEBUG_WARN("Erase failed!\n");
-			break;
-		}
-		if (full_erase)
-			target_print_progress(&timeout);
+	/*
+	 * Queue up runs of the largest erase type first, then each smaller one, and finally sectors, and run them
+	 * all with a single resume. The ROM erases in sectors up to the first aligned block of each run itself.
+	 */
+	cortexm_call_entry_s calls[SPI_FLASH_ERASE_TYPES + 1U];
+	size_t count = 0;
+	uint32_t timeout = 0;
+	for (size_t i = flash->erase_types_count; i-- > 0;) {
+		const spi_erase_type_s *const erase_type = &flash->erase_types[i];
+		if (erase_type->size <= f->blocksize || len < erase_type->size)
+			continue;
+		const uint32_t chunk = len & ~(erase_type->size - 1U);
+		cortexm_call_entry_s *const call = &calls[count++];
+		call->function = ps->rom_flash_range_erase;
+		call->args[0] = addr;
+		call->args[1] = chunk;
+		call->args[2] = erase_type->size;
+		call->args[3] = erase_type->opcode;
+		DEBUG_WARN("%" PRIu32 "k_ERASE addr 0x%08" PRIx32 " len 0x%" PRIx32 "\n", erase_type->size / 1024U, addr,
+			chunk);
+		/* Unaligned runs get up to a block's worth of sectors either side */
+		timeout += rp_flash_erase_timeout(erase_type, chunk / erase_type->size);
+		if (addr & (erase_type->size - 1U))
+			timeout += rp_flash_erase_timeout(sector_type, 2U * (erase_type->size / f->blocksize));
+		len -= chunk;
+		addr += chunk;
+	}
+	if (len) {
+		cortexm_call_entry_s *const call = &calls[count++];
+		call->function = ps->rom_flash_range_erase;
+		call->args[0] = addr;
+		call->args[1] = len;
+		call->args[2] = f->blocksize;
+		call->args[3] = flash->sector_erase_opcode;
+		DEBUG_WARN("Sector_ERASE addr 0x%08" PRIx32 " len 0x%" PRIx32 "\n", addr, (uint32_t)len);
+		timeout += rp_flash_erase_timeout(sector_type, len / f->blocksize);
 	}
+
+	const bool result = rp_rom_call_batch(t, calls, count, timeout, full_erase);
+	if (!result)
+		DEBUG_WARN("Erase failed!\n");
 	DEBUG_INFO("Erase done!\n");
 	return result;
 }
@@ -833,20 +888,37 @@ static void rp_flash_flush_cache(target_s *const t)
 // Put the SSI into a mode where XIP accesses translate to standard
 // serial 03h read commands. The flash remains in its default serial command
 // state, so will still respond to other commands.
-static void rp_flash_enter_xip(target_s *const t)
+static void rp_flash_enter_xip(target_s *const t, const rp_flash_s *const flash)
 {
 	target_mem_write32(t, RP_SSI_ENABLE, 0);
-	target_mem_write32(t, RP_SSI_CTRL0,
-		RP_SSI_CTRL0_FRF_SERIAL |         // Standard 1-bit SPI serial frames
-			RP_SSI_CTRL0_DATA_BITS(32U) | // 32 clocks per data frame
-			RP_SSI_CTRL0_TMOD_EEPROM      // Send instr + addr, receive data
-	);
-	target_mem_write32(t, RP_SSI_XIP_SPI_CTRL0,
-		RP_SSI_XIP_SPI_CTRL0_XIP_CMD(0x03U) |            // Standard 03h read
-			RP_SSI_XIP_SPI_CTRL0_INSTR_LENGTH_8b |       // 8-bit instruction prefix
-			RP_SSI_XIP_SPI_CTRL0_ADDRESS_LENGTH(0x03U) | // 24-bit addressing for 03h commands
-			RP_SSI_XIP_SPI_CTRL0_TRANS_1C1A              // Command and address both in serial format
-	);
+	if (flash && flash->read_mode_id == SPI_READ_1_1_2) {
+		target_mem_write32(t, RP_SSI_CTRL0,
+			RP_SSI_CTRL0_FRF_DUAL |           // Dual-lane frames for the data phase
+				RP_SSI_CTRL0_DATA_BITS(32U) | // 32 clocks per data frame
+				RP_SSI_CTRL0_TMOD_EEPROM      // Send instr + addr, receive data
+		);
+		// One data frame per XIP access
+		target_mem_write32(t, RP_SSI_CTRL1, 0);
+		target_mem_write32(t, RP_SSI_XIP_SPI_CTRL0,
+			RP_SSI_XIP_SPI_CTRL0_XIP_CMD(flash->read_mode.opcode) |               // Dual output read
+				RP_SSI_XIP_SPI_CTRL0_INSTR_LENGTH_8b |                            // 8-bit instruction prefix
+				RP_SSI_XIP_SPI_CTRL0_ADDRESS_LENGTH(0x03U) |                      // 24-bit addressing
+				RP_SSI_XIP_SPI_CTRL0_WAIT_CLOCKS(flash->read_mode.dummy_clocks) | // Dummy clocks from SFDP
+				RP_SSI_XIP_SPI_CTRL0_TRANS_1C1A                                   // Serial command and address
+		);
+	} else {
+		target_mem_write32(t, RP_SSI_CTRL0,
+			RP_SSI_CTRL0_FRF_SERIAL |         // Standard 1-bit SPI serial frames
+				RP_SSI_CTRL0_DATA_BITS(32U) | // 32 clocks per data frame
+				RP_SSI_CTRL0_TMOD_EEPROM      // Send instr + addr, receive data
+		);
+		target_mem_write32(t, RP_SSI_XIP_SPI_CTRL0,
+			RP_SSI_XIP_SPI_CTRL0_XIP_CMD(0x03U) |            // Standard 03h read
+				RP_SSI_XIP_SPI_CTRL0_INSTR_LENGTH_8b |       // 8-bit instruction prefix
+				RP_SSI_XIP_SPI_CTRL0_ADDRESS_LENGTH(0x03U) | // 24-bit addressing for 03h commands
+				RP_SSI_XIP_SPI_CTRL0_TRANS_1C1A              // Command and address both in serial format
+		);
+	}
 	target_mem_write32(t, RP_SSI_ENABLE, RP_SSI_ENABLE_SSI);
 }
 
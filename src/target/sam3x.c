@@ -205,6 +205,9 @@ static void sam3_add_flash(target_s *t, uint32_t eefc_base, uint32_t addr, size_
 	f->erase = sam3_flash_erase;
 	f->write = sam_flash_write;
 	f->writesize = SAM_SMALL_PAGE_SIZE;
+	f->erased = 0xffU;
+	/* Pages are erased by the Erase/Write page command in sam_flash_write() */
+	f->write_erases = true;
 	sf->eefc_base = eefc_base;
 	sf->write_cmd = EEFC_FCR_FCMD_EWP;
 	target_add_flash(t, f);
@@ -225,6 +228,7 @@ static void sam_add_flash(target_s *t, uint32_t eefc_base, uint32_t addr, size_t
 	f->erase = sam_flash_erase;
 	f->write = sam_flash_write;
 	f->writesize = SAM_LARGE_PAGE_SIZE;
+	f->erased = 0xffU;
 	sf->eefc_base = eefc_base;
 	sf->write_cmd = EEFC_FCR_FCMD_WP;
 	target_add_flash(t, f);
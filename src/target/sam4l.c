@@ -114,6 +114,9 @@
 #define CHIPID_CIDR_NVPSIZ_MASK   0xfU
 #define CHIPID_CIDR_NVPSIZ_SHIFT  8U
 
+/* Pages handed to each write call, the controller still programs them one at a time */
+#define SAM4L_WRITE_PAGES 8U
+
 /* Arbitrary time to wait for FLASH controller to be ready */
 #define FLASH_TIMEOUT 1000U /* ms */
 
@@ -141,6 +144,7 @@
 static void sam4l_extended_reset(target_s *t);
 static bool sam4l_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool sam4l_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
+static bool sam4l_flash_done(target_flash_s *f);
 
 /* Why couldn't Atmel make it sequential ... */
 static const uint32_t sam4l_ram_size[16] = {
@@ -198,7 +202,10 @@ static void sam4l_add_flash(target_s *t, uint32_t addr, size_t length)
 	f->blocksize = SAM4L_PAGE_SIZE;
 	f->erase = sam4l_flash_erase;
 	f->write = sam4l_flash_write;
+	f->done = sam4l_flash_done;
 	f->writesize = SAM4L_PAGE_SIZE;
+	f->writebufsize = SAM4L_PAGE_SIZE * SAM4L_WRITE_PAGES;
+	f->write_runs = true;
 	f->erased = 0xff;
 	/* Add it into the target structures flash chain */
 	target_add_flash(t, f);
@@ -265,6 +272,29 @@ static void sam4l_extended_reset(target_s *t)
 	target_check_error(t);
 }
 
+/*
+ * Wait for the flash controller to finish whatever it was last told to do.
+ * LOCKE and PROGE are cleared by reading FSR, so they're checked here as the
+ * result of the previous command.
+ */
+static bool sam4l_flash_wait_ready(target_s *t)
+{
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, FLASH_TIMEOUT);
+	uint32_t status = 0;
+	while (!((status = target_mem_read32(t, FLASHCALW_FSR)) & FLASHCALW_FSR_FRDY)) {
+		if (target_check_error(t) || platform_timeout_is_expired(&timeout)) {
+			DEBUG_WARN("%s: Not ready!\n", __func__);
+			return false;
+		}
+	}
+	if (status & (FLASHCALW_FSR_LOCKE | FLASHCALW_FSR_PROGE)) {
+		DEBUG_WARN("%s: Flash error, FSR: 0x%08" PRIx32 "\n", __func__, status);
+		return false;
+	}
+	return true;
+}
+
 /*
  * Helper function, wait for the flash controller to be ready to receive a
  * command. Then send it the command, page number, and the authorization
@@ -279,14 +309,8 @@ static bool sam4l_flash_command(target_s *t, uint32_t page, uint32_t cmd)
 		"%s: FSR: 0x%08" PRIx32 ", page = %" PRIu32 ", command = %" PRIu32 "\n", __func__, FLASHCALW_FSR, page, cmd);
 
 	/* Wait for Flash controller ready */
-	platform_timeout_s timeout;
-	platform_timeout_set(&timeout, FLASH_TIMEOUT);
-	while (!(target_mem_read32(t, FLASHCALW_FSR) & FLASHCALW_FSR_FRDY)) {
-		if (platform_timeout_is_expired(&timeout)) {
-			DEBUG_WARN("%s: Not ready!\n", __func__);
-			return false;
-		}
-	}
+	if (!sam4l_flash_wait_ready(t))
+		return false;
 
 	/* Load up the new command */
 	const uint32_t cmd_reg = (cmd & FLASHCALW_FCMD_CMD_MASK) |
@@ -304,38 +328,49 @@ static bool sam4l_flash_write(
 	target_flash_s *const f, const target_addr_t dest, const void *const src, const size_t len)
 {
 	DEBUG_INFO("%s: dest = 0x%08" PRIx32 ", len %" PRIx32 "\n", __func__, dest, (uint32_t)len);
-	/* Writing any more or less than 1 page size is not supported by this for now */
-	if (len != SAM4L_PAGE_SIZE)
+	/* The target Flash API only ever hands us whole, aligned pages */
+	if (len % SAM4L_PAGE_SIZE)
 		return false;
 
 	target_s *t = f->t;
-	/* This will fail with unaligned writes, however the target Flash API guarantees we're called aligned */
-	const uint16_t page = dest / SAM4L_PAGE_SIZE;
+	const uint8_t *const data = src;
 
-	/* Clear the page buffer */
-	if (!sam4l_flash_command(t, 0, FLASH_CMD_CPB))
-		return false;
+	for (size_t offset = 0; offset < len; offset += SAM4L_PAGE_SIZE) {
+		const target_addr_t page_addr = dest + offset;
+		const uint16_t page = page_addr / SAM4L_PAGE_SIZE;
 
-	/* Now fill page buffer with our 512 bytes of data */
+		/*
+		 * Clear the page buffer, waiting out the previous page's WP first. CPB has to have finished before
+		 * the fill starts, otherwise it can still be setting doublewords back to 0xff as they're written.
+		 */
+		if (!sam4l_flash_command(t, 0, FLASH_CMD_CPB) || !sam4l_flash_wait_ready(t))
+			return false;
 
-	const uint32_t *const data = src;
-	/* I did try to use target_mem_write however that resulted in the
-	 * last 64 bits (8 bytes) to be incorrect on even pages (0, 2, 4, ...)
-	 * since it works this way I've not investigated further.
-	 */
-	for (size_t offset = 0; offset < SAM4L_PAGE_SIZE; offset += 4U) {
 		/*
- 		 * The page buffer overlaps flash, its only 512 bytes long
-		 * and no matter where you write it from it goes to the page
-		 * you point it to. So we don't need the specific address here
-		 * instead we just write 0 -> pagelen (512) and that fills our
-		 * buffer correctly.
+		 * The page buffer overlaps flash, its only 512 bytes long and no matter where you write it from it goes
+		 * to the page you point it to, so it's filled through the page's own address in one bulk transfer.
+		 *
+		 * It is organised as 64 doublewords and only latches a doubleword once its upper word has arrived, so if
+		 * WP is issued while the last write of the fill is still posted in the AP, the final 8 bytes are lost.
+		 * That is what the old bulk fill showed on even pages, which end inside a 1KiB TAR auto-increment window;
+		 * odd pages end on the boundary, where the TAR rewrite pushed the last write through first. Checking
+		 * for errors forces the transfer to complete before WP, so the bulk fill works for every page.
 		 */
-		target_mem_write32(t, dest + offset, data[offset / 4U]);
+		target_mem_write(t, page_addr, data + offset, SAM4L_PAGE_SIZE);
+		if (target_check_error(t))
+			return false;
+
+		/* Write the page, the next CPB (or the done hook) waits for it to finish */
+		if (!sam4l_flash_command(t, page, FLASH_CMD_WP))
+			return false;
 	}
+	return true;
+}
 
-	/* write the page */
-	return sam4l_flash_command(t, page, FLASH_CMD_WP);
+/* Wait for the last page write to land so it can be verified */
+static bool sam4l_flash_done(target_flash_s *const f)
+{
+	return sam4l_flash_wait_ready(f->t);
 }
 
 /* Erase flash across the addresses specified by addr and len */
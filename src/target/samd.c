@@ -43,6 +43,8 @@
 
 static bool samd_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool samd_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
+static bool samd_flash_prepare(target_flash_s *f);
+static bool samd_flash_done(target_flash_s *f);
 /* NB: This is not marked static on purpose as it's used by samx5x.c. */
 bool samd_mass_erase(target_s *t);
 
@@ -70,6 +72,9 @@ const command_s samd_cmd_list[] = {
 /* Non-Volatile Memory Controller (NVMC) Parameters */
 #define SAMD_ROW_SIZE  256U
 #define SAMD_PAGE_SIZE 64U
+/* Pages handed to each write call, streamed through the page buffer with automatic page writes */
+#define SAMD_WRITE_PAGES  16U
+#define SAMD_LOCK_REGIONS 16U
 
 /* -------------------------------------------------------------------------- */
 /* Non-Volatile Memory Controller (NVMC) Registers */
@@ -82,6 +87,7 @@ const command_s samd_cmd_list[] = {
 #define SAMD_NVMC_INTFLAG (SAMD_NVMC + 0x14U)
 #define SAMD_NVMC_STATUS  (SAMD_NVMC + 0x18U)
 #define SAMD_NVMC_ADDRESS (SAMD_NVMC + 0x1cU)
+#define SAMD_NVMC_LOCK    (SAMD_NVMC + 0x20U)
 
 /* Control A Register (CTRLA) */
 #define SAMD_CTRLA_CMD_KEY             0xa500U
@@ -95,8 +101,12 @@ const command_s samd_cmd_list[] = {
 #define SAMD_CTRLA_CMD_SSB             0x0045U
 #define SAMD_CTRLA_CMD_INVALL          0x0046U
 
+/* Control B Register (CTRLB) */
+#define SAMD_CTRLB_MANW (1U << 7U) /* Manual write, otherwise the last word of a page starts its write */
+
 /* Interrupt Flag Register (INTFLAG) */
 #define SAMD_NVMC_READY (1U << 0U)
+#define SAMD_NVMC_ERROR (1U << 1U)
 
 /* Non-Volatile Memory Calibration and Auxiliary Registers */
 #define SAMD_NVM_USER_ROW_LOW  0x00804000U
@@ -470,20 +480,37 @@ samd_descr_s samd_parse_device_id(uint32_t did)
 	return samd;
 }
 
+/*
+ * Region lock state is tracked across a flash session so each region is unlocked at most once,
+ * and only the regions unlocked for the session are locked again in done
+ */
+typedef struct samd_flash {
+	target_flash_s f;
+	uint16_t unlocked; /* LOCK as of now, a set bit is an unlocked region */
+	uint16_t relock;   /* Regions unlocked by us, to be locked again */
+	uint32_t ctrlb;    /* CTRLB to put back when done */
+} samd_flash_s;
+
 static void samd_add_flash(target_s *t, uint32_t addr, size_t length)
 {
-	target_flash_s *f = calloc(1, sizeof(*f));
-	if (!f) { /* calloc failed: heap exhaustion */
+	samd_flash_s *sf = calloc(1, sizeof(*sf));
+	if (!sf) { /* calloc failed: heap exhaustion */
 		DEBUG_WARN("calloc: failed in %s\n", __func__);
 		return;
 	}
 
+	target_flash_s *f = &sf->f;
 	f->start = addr;
 	f->length = length;
 	f->blocksize = SAMD_ROW_SIZE;
 	f->erase = samd_flash_erase;
 	f->write = samd_flash_write;
+	f->prepare = samd_flash_prepare;
+	f->done = samd_flash_done;
 	f->writesize = SAMD_PAGE_SIZE;
+	f->writebufsize = SAMD_PAGE_SIZE * SAMD_WRITE_PAGES;
+	f->write_runs = true;
+	f->erased = 0xffU;
 	target_add_flash(t, f);
 }
 
@@ -587,11 +614,11 @@ static void samd_unlock_current_address(target_s *t)
 static bool samd_wait_nvm_ready(target_s *t)
 {
 	/* Poll for NVM Ready */
-	while ((target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_READY) == 0) {
+	while (!target_mem_poll32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY, SAMD_NVMC_READY, TARGET_POLL_SLICE)) {
 		if (target_check_error(t))
 			return false;
 	}
-	return true;
+	return !target_check_error(t);
 }
 
 static bool samd_wait_dsu_ready(target_s *const t, uint32_t *const result, platform_timeout_s *const timeout)
@@ -608,10 +635,72 @@ static bool samd_wait_dsu_ready(target_s *const t, uint32_t *const result, platf
 	return true;
 }
 
+static bool samd_flash_prepare(target_flash_s *f)
+{
+	samd_flash_s *sf = (samd_flash_s *)f;
+	target_s *t = f->t;
+
+	sf->unlocked = target_mem_read16(t, SAMD_NVMC_LOCK);
+	sf->relock = 0;
+	/* Start the session with no stale error for the writes to trip over */
+	target_mem_write32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_ERROR);
+
+	/* Switch to automatic page writes, the last word written to the page buffer starts the write */
+	sf->ctrlb = target_mem_read32(t, SAMD_NVMC_CTRLB);
+	target_mem_write32(t, SAMD_NVMC_CTRLB, sf->ctrlb & ~SAMD_CTRLB_MANW);
+	return !target_check_error(t);
+}
+
+static bool samd_flash_done(target_flash_s *f)
+{
+	samd_flash_s *sf = (samd_flash_s *)f;
+	target_s *t = f->t;
+	const size_t region_size = f->length / SAMD_LOCK_REGIONS;
+
+	bool result = true;
+	/* Temporary (until next reset) locking of the regions we unlocked */
+	for (size_t region = 0; region < SAMD_LOCK_REGIONS; ++region) {
+		if (!(sf->relock & (1U << region)))
+			continue;
+		target_mem_write32(t, SAMD_NVMC_ADDRESS, (f->start + region * region_size) >> 1U);
+		samd_lock_current_address(t);
+		result &= samd_wait_nvm_ready(t);
+	}
+	sf->unlocked &= ~sf->relock;
+	sf->relock = 0;
+
+	target_mem_write32(t, SAMD_NVMC_CTRLB, sf->ctrlb);
+	return result && !target_check_error(t);
+}
+
+/* Unlock each region overlapping addr to addr + len that isn't already */
+static bool samd_flash_unlock(samd_flash_s *sf, target_addr_t addr, size_t len)
+{
+	target_s *t = sf->f.t;
+	const size_t region_size = sf->f.length / SAMD_LOCK_REGIONS;
+	const size_t first = (addr - sf->f.start) / region_size;
+	const size_t last = (addr + len - 1U - sf->f.start) / region_size;
+	for (size_t region = first; region <= last && region < SAMD_LOCK_REGIONS; ++region) {
+		if (sf->unlocked & (1U << region))
+			continue;
+		/* Must be shifted right for 16-bit address, see Datasheet §20.8.8 Address */
+		target_mem_write32(t, SAMD_NVMC_ADDRESS, (sf->f.start + region * region_size) >> 1U);
+		samd_unlock_current_address(t);
+		if (!samd_wait_nvm_ready(t))
+			return false;
+		sf->unlocked |= 1U << region;
+		sf->relock |= 1U << region;
+	}
+	return true;
+}
+
 /* Erase flash row by row */
 static bool samd_flash_erase(target_flash_s *const f, const target_addr_t addr, const size_t len)
 {
 	target_s *t = f->t;
+	if (!samd_flash_unlock((samd_flash_s *)f, addr, len))
+		return false;
+
 	for (size_t offset = 0; offset < len; offset += f->blocksize) {
 		/*
 		 * Write address of first word in row to erase it
@@ -619,42 +708,36 @@ static bool samd_flash_erase(target_flash_s *const f, const target_addr_t addr,
 		 */
 		target_mem_write32(t, SAMD_NVMC_ADDRESS, (addr + offset) >> 1U);
 
-		/* Unlock */
-		samd_unlock_current_address(t);
-
 		/* Issue the erase command */
 		target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_ERASEROW);
 		if (!samd_wait_nvm_ready(t))
 			return false;
-
-		/* Lock */
-		samd_lock_current_address(t);
 	}
 
 	return true;
 }
 
 /*
- * Write flash page by page
+ * Write whole pages with automatic page writes: the pages are streamed in one go and each page's
+ * write starts as its last word lands, the bus being stalled while the NVM is busy, so there's just
+ * a single wait for the last page.
  */
 static bool samd_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
 {
 	target_s *t = f->t;
+	if (!samd_flash_unlock((samd_flash_s *)f, dest, len))
+		return false;
 
-	/* Write within a single page. This may be part or all of the page */
 	target_mem_write(t, dest, src, len);
-
-	/* Unlock */
-	samd_unlock_current_address(t);
-
-	/* Issue the write page command */
-	target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_WRITEPAGE);
 	if (!samd_wait_nvm_ready(t))
 		return false;
 
-	/* Lock */
-	samd_lock_current_address(t);
-
+	/* INTFLAG.ERROR collects any lock or programming error from the whole run */
+	if (target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_ERROR) {
+		target_mem_write32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_ERROR);
+		DEBUG_WARN("Error writing flash at 0x%08" PRIx32 " (len 0x%08" PRIx32 ")\n", dest, (uint32_t)len);
+		return false;
+	}
 	return true;
 }
 
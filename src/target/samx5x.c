@@ -42,6 +42,8 @@
 
 static bool samx5x_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool samx5x_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
+static bool samx5x_flash_prepare(target_flash_s *f);
+static bool samx5x_flash_done(target_flash_s *f);
 static bool samx5x_cmd_lock_flash(target_s *t, int argc, const char **argv);
 static bool samx5x_cmd_unlock_flash(target_s *t, int argc, const char **argv);
 static bool samx5x_cmd_unlock_bootprot(target_s *t, int argc, const char **argv);
@@ -86,6 +88,9 @@ const command_s samx5x_cmd_list[] = {
 /* Non-Volatile Memory Controller (NVMC) Parameters */
 #define SAMX5X_PAGE_SIZE  UINT32_C(512)
 #define SAMX5X_BLOCK_SIZE (SAMX5X_PAGE_SIZE * 16U)
+/* Pages handed to each write call, streamed through the page buffer in automatic page write mode */
+#define SAMX5X_WRITE_PAGES 8U
+#define SAMX5X_LOCK_REGIONS 32U
 
 /* Non-Volatile Memory Controller (NVMC) Registers */
 #define SAMX5X_NVMC         0x41004000U
@@ -97,6 +102,10 @@ const command_s samx5x_cmd_list[] = {
 #define SAMX5X_NVMC_ADDRESS (SAMX5X_NVMC + 0x14U)
 #define SAMX5X_NVMC_RUNLOCK (SAMX5X_NVMC + 0x18U)
 
+/* Control A Register (CTRLA) */
+#define SAMX5X_CTRLA_WMODE_MASK (3U << 4U)
+#define SAMX5X_CTRLA_WMODE_AP   (3U << 4U) /* Automatic page write */
+
 /* Control B Register (CTRLB) */
 #define SAMX5X_CTRLB_CMD_KEY             0xa500U
 #define SAMX5X_CTRLB_CMD_ERASEPAGE       0x0000U
@@ -293,20 +302,38 @@ samx5x_descr_s samx5x_parse_device_id(uint32_t did)
 	return samd;
 }
 
+/*
+ * Region lock state is tracked across a flash session so each region is unlocked at most once,
+ * and only the regions unlocked for the session are locked again in done
+ */
+typedef struct samx5x_flash {
+	target_flash_s f;
+	uint32_t unlocked; /* RUNLOCK as of now, a set bit is an unlocked region */
+	uint32_t relock;   /* Regions unlocked by us, to be locked again */
+	uint32_t lock_region_size;
+	uint16_t ctrla; /* CTRLA to put back when done */
+} samx5x_flash_s;
+
 static void samx5x_add_flash(target_s *t, uint32_t addr, size_t length, size_t erase_block_size, size_t write_page_size)
 {
-	target_flash_s *f = calloc(1, sizeof(*f));
-	if (!f) { /* calloc failed: heap exhaustion */
+	samx5x_flash_s *sf = calloc(1, sizeof(*sf));
+	if (!sf) { /* calloc failed: heap exhaustion */
 		DEBUG_INFO("calloc: failed in %s\n", __func__);
 		return;
 	}
 
+	target_flash_s *f = &sf->f;
 	f->start = addr;
 	f->length = length;
 	f->blocksize = erase_block_size;
 	f->erase = samx5x_flash_erase;
 	f->write = samx5x_flash_write;
+	f->prepare = samx5x_flash_prepare;
+	f->done = samx5x_flash_done;
 	f->writesize = write_page_size;
+	f->writebufsize = write_page_size * SAMX5X_WRITE_PAGES;
+	f->write_runs = true;
+	f->erased = 0xffU;
 	target_add_flash(t, f);
 }
 
@@ -447,9 +474,76 @@ static bool samx5x_check_nvm_error(target_s *t)
 	"\tClearing these before proceeding:\n"                      \
 	"\t    "
 
+static bool samx5x_wait_nvm_ready(target_s *t)
+{
+	/* Poll for NVM Ready */
+	while (!(target_mem_read16(t, SAMX5X_NVMC_STATUS) & SAMX5X_STATUS_READY)) {
+		if (target_check_error(t))
+			return false;
+	}
+	return !target_check_error(t);
+}
+
+static bool samx5x_flash_prepare(target_flash_s *f)
+{
+	samx5x_flash_s *sf = (samx5x_flash_s *)f;
+	target_s *t = f->t;
+
+	const uint32_t flash_size = (target_mem_read32(t, SAMX5X_NVMC_PARAM) & 0xffffU) * SAMX5X_PAGE_SIZE;
+	sf->lock_region_size = flash_size / SAMX5X_LOCK_REGIONS;
+	sf->unlocked = target_mem_read32(t, SAMX5X_NVMC_RUNLOCK);
+	sf->relock = 0;
+
+	/* Switch to automatic page writes, the last word written to the page buffer starts the write */
+	sf->ctrla = target_mem_read16(t, SAMX5X_NVMC_CTRLA);
+	target_mem_write16(t, SAMX5X_NVMC_CTRLA, (sf->ctrla & ~SAMX5X_CTRLA_WMODE_MASK) | SAMX5X_CTRLA_WMODE_AP);
+	return !target_check_error(t) && sf->lock_region_size;
+}
+
+static bool samx5x_flash_done(target_flash_s *f)
+{
+	samx5x_flash_s *sf = (samx5x_flash_s *)f;
+	target_s *t = f->t;
+
+	bool result = true;
+	/* Temporary (until next reset) locking of the regions we unlocked */
+	for (size_t region = 0; region < SAMX5X_LOCK_REGIONS; ++region) {
+		if (!(sf->relock & (1U << region)))
+			continue;
+		target_mem_write32(t, SAMX5X_NVMC_ADDRESS, f->start + region * sf->lock_region_size);
+		samx5x_lock_current_address(t);
+		result &= samx5x_wait_nvm_ready(t);
+	}
+	sf->unlocked &= ~sf->relock;
+	sf->relock = 0;
+
+	target_mem_write16(t, SAMX5X_NVMC_CTRLA, sf->ctrla);
+	return result && !target_check_error(t);
+}
+
+/* Unlock each region overlapping addr to addr + len that isn't already */
+static bool samx5x_flash_unlock(samx5x_flash_s *sf, target_addr_t addr, size_t len)
+{
+	target_s *t = sf->f.t;
+	const size_t first = (addr - sf->f.start) / sf->lock_region_size;
+	const size_t last = (addr + len - 1U - sf->f.start) / sf->lock_region_size;
+	for (size_t region = first; region <= last && region < SAMX5X_LOCK_REGIONS; ++region) {
+		if (sf->unlocked & (1U << region))
+			continue;
+		target_mem_write32(t, SAMX5X_NVMC_ADDRESS, sf->f.start + region * sf->lock_region_size);
+		samx5x_unlock_current_address(t);
+		if (!samx5x_wait_nvm_ready(t))
+			return false;
+		sf->unlocked |= 1U << region;
+		sf->relock |= 1U << region;
+	}
+	return true;
+}
+
 /* Erase flash block by block */
 static bool samx5x_flash_erase(target_flash_s *f, target_addr_t addr, size_t len)
 {
+	samx5x_flash_s *sf = (samx5x_flash_s *)f;
 	target_s *t = f->t;
 	const uint16_t errs = samx5x_read_nvm_error(t);
 	if (errs) {
@@ -458,54 +552,39 @@ static bool samx5x_flash_erase(target_flash_s *f, target_addr_t addr, size_t len
 		samx5x_clear_nvm_error(t);
 	}
 
-	/* Check if the bootprot or region lock settings are going to prevent erasing flash. */
+	/* Check if the bootprot settings are going to prevent erasing flash. */
 	const uint16_t bootprot = (target_mem_read16(t, SAMX5X_NVMC_STATUS) >> 8U) & 0xfU;
-	const uint32_t runlock = target_mem_read32(t, SAMX5X_NVMC_RUNLOCK);
-	const uint32_t flash_size = (target_mem_read32(t, SAMX5X_NVMC_PARAM) & 0xffffU) * SAMX5X_PAGE_SIZE;
-	const uint32_t lock_region_size = flash_size >> 5U;
-
 	if (addr < (15U - bootprot) * 8192U) {
 		DEBUG_WARN("Bootprot\n");
 		return false;
 	}
 
-	if (~runlock & (1U << (addr / lock_region_size))) {
-		DEBUG_WARN("runlock\n");
+	if (!samx5x_flash_unlock(sf, addr, len))
 		return false;
-	}
 
 	for (size_t offset = 0; offset < len; offset += f->blocksize) {
 		target_mem_write32(t, SAMX5X_NVMC_ADDRESS, addr + offset);
 
-		/* Unlock */
-		samx5x_unlock_current_address(t);
-
 		/* Issue the erase command */
 		target_mem_write32(t, SAMX5X_NVMC_CTRLB, SAMX5X_CTRLB_CMD_KEY | SAMX5X_CTRLB_CMD_ERASEBLOCK);
 
-		/* Poll for NVM Ready */
-		while ((target_mem_read32(t, SAMX5X_NVMC_STATUS) & SAMX5X_STATUS_READY) == 0) {
-			if (target_check_error(t) || samx5x_check_nvm_error(t)) {
-				DEBUG_WARN("NVM Ready\n");
-				return false;
-			}
-		}
-
-		if (target_check_error(t) || samx5x_check_nvm_error(t)) {
-			DEBUG_WARN("Error\n");
+		if (!samx5x_wait_nvm_ready(t) || samx5x_check_nvm_error(t)) {
+			DEBUG_WARN("Error erasing flash block at 0x%08" PRIx32 "\n", addr + (uint32_t)offset);
 			return false;
 		}
-
-		/* Lock */
-		samx5x_lock_current_address(t);
 	}
 
 	return true;
 }
 
-/* Write flash page by page */
+/*
+ * Write whole pages in automatic page write mode: the page buffer is streamed in one go and each
+ * page's write starts as its last word lands, the bus being stalled while the NVM is busy, so there's
+ * just a single wait for the last page and one error check for the lot.
+ */
 static bool samx5x_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
 {
+	samx5x_flash_s *sf = (samx5x_flash_s *)f;
 	target_s *t = f->t;
 	const uint16_t errs = samx5x_read_nvm_error(t);
 	if (errs) {
@@ -514,32 +593,15 @@ static bool samx5x_flash_write(target_flash_s *f, target_addr_t dest, const void
 		samx5x_clear_nvm_error(t);
 	}
 
-	bool error = false;
-	/* Unlock */
-	target_mem_write32(t, SAMX5X_NVMC_ADDRESS, dest);
-	samx5x_unlock_current_address(t);
+	if (!samx5x_flash_unlock(sf, dest, len))
+		return false;
 
-	/* Write within a single page. This may be part or all of the page */
 	target_mem_write(t, dest, src, len);
 
-	/* Issue the write page command */
-	target_mem_write32(t, SAMX5X_NVMC_CTRLB, SAMX5X_CTRLB_CMD_KEY | SAMX5X_CTRLB_CMD_WRITEPAGE);
-
-	/* Poll for NVM Ready */
-	while ((target_mem_read32(t, SAMX5X_NVMC_STATUS) & SAMX5X_STATUS_READY) == 0) {
-		if (target_check_error(t) || samx5x_check_nvm_error(t)) {
-			error = true;
-			break;
-		}
-	}
-
-	if (error || target_check_error(t) || samx5x_check_nvm_error(t)) {
+	if (!samx5x_wait_nvm_ready(t) || samx5x_check_nvm_error(t)) {
 		DEBUG_WARN("Error writing flash page at 0x%08" PRIx32 " (len 0x%08" PRIx32 ")\n", dest, (uint32_t)len);
 		return false;
 	}
-
-	/* Lock */
-	samx5x_lock_current_address(t);
 	return true;
 }
 
@@ -64,27 +64,146 @@ static inline size_t sfdp_memory_density_to_capacity_bits(const uint8_t *const d
 		return SFDP_DENSITY_VALUE(density) + 1U;
 }
 
+static const uint16_t sfdp_erase_time_units_ms[4] = {1U, 16U, 128U, 1000U};
+/* 4-byte address forms of the reads, in spi_read_mode_id_e order to match the instruction table support bits */
+static const uint8_t sfdp_4b_read_opcodes[SPI_READ_MODES] = {0x13U, 0x0cU, 0x3cU, 0xbcU, 0x6cU, 0xecU};
+
+static void sfdp_set_read_mode(spi_read_mode_s *const mode, const timings_and_opcode_s *const timings)
+{
+	mode->supported = true;
+	mode->opcode = timings->opcode;
+	mode->dummy_clocks = SFDP_READ_DUMMY_CLOCKS(*timings);
+	mode->mode_clocks = SFDP_READ_MODE_CLOCKS(*timings);
+}
+
+static void sfdp_read_erase_types(
+	spi_parameters_s *const params, const sfdp_basic_parameter_table_s *const parameter_table, const bool has_timings)
+{
+	/*
+	 * Keep these in table order for now so the 4-byte instruction table can index them,
+	 * sfdp_sort_erase_types() then drops the unused entries
+	 */
+	params->erase_types_count = SFDP_ERASE_TYPES;
+	for (size_t i = 0; i < SFDP_ERASE_TYPES; ++i) {
+		const erase_parameters_s *const erase_type = &parameter_table->erase_types[i];
+		spi_erase_type_s *const result = &params->erase_types[i];
+		/* A size exponent of 0 marks the erase type as not present */
+		result->size = erase_type->erase_size_exponent ? SFDP_ERASE_SIZE(erase_type) : 0U;
+		result->opcode = erase_type->opcode;
+		result->opcode_4b = 0U;
+		result->typical_ms = 0U;
+		result->max_ms = 0U;
+		if (has_timings) {
+			const uint32_t time = SFDP_ERASE_TIME(parameter_table->erase_timing, i);
+			result->typical_ms = SFDP_ERASE_TIME_COUNT(time) * sfdp_erase_time_units_ms[SFDP_ERASE_TIME_UNIT(time)];
+			result->max_ms = 2U * SFDP_ERASE_TIME_MULTIPLIER(parameter_table->erase_timing) * result->typical_ms;
+		}
+	}
+}
+
 static spi_parameters_s sfdp_read_basic_parameter_table(
 	target_s *const t, const uint32_t address, const size_t length, const read_sfdp_func sfdp_read)
 {
+	/* Older (JESD216 rev 0) tables are shorter, so make sure anything not read back reads as 0 */
 	sfdp_basic_parameter_table_s parameter_table;
+	memset(&parameter_table, 0, sizeof(parameter_table));
 	const size_t table_length = MIN(sizeof(sfdp_basic_parameter_table_s), length);
 	sfdp_read(t, address, &parameter_table, table_length);
 
 	spi_parameters_s result;
+	memset(&result, 0, sizeof(result));
 	result.capacity = sfdp_memory_density_to_capacity_bits(parameter_table.memory_density) >> 3U;
-	for (size_t i = 0; i < SFDP_ERASE_TYPES; ++i) {
-		erase_parameters_s *erase_type = &parameter_table.erase_types[i];
-		if (erase_type->opcode == parameter_table.sector_erase_opcode) {
+	/* The erase timings and 4-byte addressing information only exist from JESD216A on */
+	sfdp_read_erase_types(
+		&result, &parameter_table, table_length >= offsetof(sfdp_basic_parameter_table_s, erase_timing) + 4U);
+	for (size_t i = 0; i < result.erase_types_count; ++i) {
+		const spi_erase_type_s *const erase_type = &result.erase_types[i];
+		if (erase_type->size && erase_type->opcode == parameter_table.sector_erase_opcode) {
 			result.sector_erase_opcode = erase_type->opcode;
-			result.sector_size = SFDP_ERASE_SIZE(erase_type);
+			result.sector_size = erase_type->size;
 			break;
 		}
 	}
+	/* If the 4KiB erase is not available, fall back to the smallest erase type the Flash has */
+	if (!result.sector_size) {
+		const spi_erase_type_s *smallest = NULL;
+		for (size_t i = 0; i < result.erase_types_count; ++i) {
+			const spi_erase_type_s *const erase_type = &result.erase_types[i];
+			if (erase_type->size && (!smallest || erase_type->size < smallest->size))
+				smallest = erase_type;
+		}
+		if (smallest) {
+			result.sector_erase_opcode = smallest->opcode;
+			result.sector_size = smallest->size;
+		}
+	}
 	result.page_size = SFDP_PAGE_SIZE(parameter_table);
+
+	switch (SFDP_ADDRESS_BYTES(parameter_table.value2)) {
+	case SFDP_ADDRESS_BYTES_3B_OR_4B:
+		result.address_modes = SPI_FLASH_ADDRESS_3B | SPI_FLASH_ADDRESS_4B;
+		break;
+	case SFDP_ADDRESS_BYTES_4B:
+		result.address_modes = SPI_FLASH_ADDRESS_4B;
+		break;
+	default:
+		result.address_modes = SPI_FLASH_ADDRESS_3B;
+		break;
+	}
+	if (table_length >= sizeof(sfdp_basic_parameter_table_s))
+		result.enter_4b_methods = SFDP_ENTER_4B_METHODS(parameter_table.status_and_addressing_mode);
+
+	/* Every SFDP capable Flash does the normal and fast reads, the rest are optional */
+	result.read_modes[SPI_READ_1_1_1] = (spi_read_mode_s){.supported = true, .opcode = 0x03U};
+	result.read_modes[SPI_READ_FAST_1_1_1] = (spi_read_mode_s){.supported = true, .opcode = 0x0bU, .dummy_clocks = 8U};
+	if (parameter_table.value2 & SFDP_SUPPORTS_FAST_1_1_2)
+		sfdp_set_read_mode(&result.read_modes[SPI_READ_1_1_2], &parameter_table.fast_dual_output);
+	if (parameter_table.value2 & SFDP_SUPPORTS_FAST_1_2_2)
+		sfdp_set_read_mode(&result.read_modes[SPI_READ_1_2_2], &parameter_table.fast_dual_io);
+	if (parameter_table.value2 & SFDP_SUPPORTS_FAST_1_1_4)
+		sfdp_set_read_mode(&result.read_modes[SPI_READ_1_1_4], &parameter_table.fast_quad_output);
+	if (parameter_table.value2 & SFDP_SUPPORTS_FAST_1_4_4)
+		sfdp_set_read_mode(&result.read_modes[SPI_READ_1_4_4], &parameter_table.fast_quad_io);
 	return result;
 }
 
+static void sfdp_read_4byte_instruction_table(target_s *const t, const uint32_t address, const size_t length,
+	const read_sfdp_func sfdp_read, spi_parameters_s *const params)
+{
+	sfdp_4byte_instruction_table_s instruction_table;
+	memset(&instruction_table, 0, sizeof(instruction_table));
+	sfdp_read(t, address, &instruction_table, MIN(sizeof(instruction_table), length));
+
+	for (size_t mode = 0; mode < SPI_READ_MODES; ++mode) {
+		if (params->read_modes[mode].supported && (instruction_table.supported_instructions & (1U << mode)))
+			params->read_modes[mode].opcode_4b = sfdp_4b_read_opcodes[mode];
+	}
+	if (instruction_table.supported_instructions & SFDP_4B_PAGE_PROGRAM)
+		params->page_program_opcode_4b = SFDP_4B_PAGE_PROGRAM_CMD;
+	/* The erase opcodes are indexed by erase type in the basic table */
+	for (size_t i = 0; i < SFDP_ERASE_TYPES; ++i) {
+		if (params->erase_types[i].size && (instruction_table.supported_instructions & SFDP_4B_ERASE_TYPE(i)))
+			params->erase_types[i].opcode_4b = instruction_table.erase_opcodes[i];
+	}
+	params->enter_4b_methods |= SPI_FLASH_4B_INSTRUCTION_SET;
+}
+
+static void sfdp_sort_erase_types(spi_parameters_s *const params)
+{
+	/* Insertion sort the erase types present into ascending size order */
+	size_t count = 0;
+	for (size_t i = 0; i < params->erase_types_count; ++i) {
+		const spi_erase_type_s erase_type = params->erase_types[i];
+		if (!erase_type.size)
+			continue;
+		size_t j = count++;
+		for (; j > 0 && params->erase_types[j - 1U].size > erase_type.size; --j)
+			params->erase_types[j] = params->erase_types[j - 1U];
+		params->erase_types[j] = erase_type;
+	}
+	params->erase_types_count = count;
+}
+
 bool sfdp_read_parameters(target_s *const t, spi_parameters_s *params, const read_sfdp_func sfdp_read)
 {
 	sfdp_header_s header;
@@ -93,17 +212,39 @@ bool sfdp_read_parameters(target_s *const t, spi_parameters_s *params, const rea
 	if (memcmp(header.magic, SFDP_MAGIC, 4) != 0)
 		return false;
 
+	bool have_basic_table = false;
+	uint32_t instruction_table_address = 0U;
+	uint16_t instruction_table_length = 0U;
 	for (size_t i = 0; i <= header.parameter_headers_count; ++i) {
 		sfdp_parameter_table_header_s table_header;
 		sfdp_read(t, SFDP_TABLE_HEADER_ADDRESS + (sizeof(table_header) * i), &table_header, sizeof(table_header));
 		sfdp_debug_print(SFDP_TABLE_HEADER_ADDRESS + (sizeof(table_header) * i), &table_header, sizeof(table_header));
 		const uint16_t jedec_parameter_id = SFDP_JEDEC_PARAMETER_ID(table_header);
-		if (jedec_parameter_id == SFDP_BASIC_SPI_PARAMETER_TABLE) {
-			const uint32_t table_address = SFDP_TABLE_ADDRESS(table_header);
-			const uint16_t table_length = table_header.table_length_in_u32s * 4U;
+		const uint32_t table_address = SFDP_TABLE_ADDRESS(table_header);
+		const uint16_t table_length = table_header.table_length_in_u32s * 4U;
+		if (jedec_parameter_id == SFDP_BASIC_SPI_PARAMETER_TABLE && !have_basic_table) {
 			*params = sfdp_read_basic_parameter_table(t, table_address, table_length, sfdp_read);
-			return true;
+			have_basic_table = true;
+		} else if (jedec_parameter_id == SFDP_4BYTE_INSTRUCTION_TABLE) {
+			instruction_table_address = table_address;
+			instruction_table_length = table_length;
 		}
 	}
-	return false;
+	if (!have_basic_table)
+		return false;
+	/* The 4-byte instruction table refines the basic table, so can only be applied once that's been read */
+	if (instruction_table_length)
+		sfdp_read_4byte_instruction_table(t, instruction_table_address, instruction_table_length, sfdp_read, params);
+	sfdp_sort_erase_types(params);
+	return true;
+}
+
+spi_read_mode_id_e sfdp_fastest_read_mode(const spi_parameters_s *const params, const uint32_t usable_modes)
+{
+	/* The modes are enumerated slowest first, so walk them backwards for the first one we can use */
+	for (size_t mode = SPI_READ_MODES; mode-- > SPI_READ_FAST_1_1_1;) {
+		if (params->read_modes[mode].supported && (usable_modes & SPI_READ_MODE_MASK(mode)))
+			return (spi_read_mode_id_e)mode;
+	}
+	return SPI_READ_1_1_1;
 }
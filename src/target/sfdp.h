@@ -46,15 +46,66 @@ typedef struct spi_flash_id {
 	uint8_t capacity;
 } spi_flash_id_s;
 
+#define SPI_FLASH_ERASE_TYPES 4U
+
+/* Addressing modes the Flash can be driven in */
+#define SPI_FLASH_ADDRESS_3B (1U << 0U)
+#define SPI_FLASH_ADDRESS_4B (1U << 1U)
+
+/* Ways to switch the Flash into 4-byte addressing, as given by the JEDEC basic parameter table */
+#define SPI_FLASH_4B_ENTER_B7        (1U << 0U)
+#define SPI_FLASH_4B_ENTER_WREN_B7   (1U << 1U)
+#define SPI_FLASH_4B_ENTER_EXT_ADDR  (1U << 2U)
+#define SPI_FLASH_4B_ENTER_BANK      (1U << 3U)
+#define SPI_FLASH_4B_ENTER_NV_CONFIG (1U << 4U)
+#define SPI_FLASH_4B_INSTRUCTION_SET (1U << 5U)
+#define SPI_FLASH_4B_ALWAYS          (1U << 6U)
+
+typedef enum spi_read_mode_id {
+	SPI_READ_1_1_1,      /* 03h read, no dummy cycles */
+	SPI_READ_FAST_1_1_1, /* 0bh fast read */
+	SPI_READ_1_1_2,      /* Dual output */
+	SPI_READ_1_2_2,      /* Dual I/O */
+	SPI_READ_1_1_4,      /* Quad output */
+	SPI_READ_1_4_4,      /* Quad I/O */
+	SPI_READ_MODES,
+} spi_read_mode_id_e;
+
+#define SPI_READ_MODE_MASK(mode) (1U << (mode))
+
+typedef struct spi_read_mode {
+	bool supported;
+	uint8_t opcode;
+	uint8_t opcode_4b; /* 0 if there is no 4-byte address form of this read */
+	uint8_t dummy_clocks;
+	uint8_t mode_clocks;
+} spi_read_mode_s;
+
+typedef struct spi_erase_type {
+	uint32_t size;
+	uint32_t typical_ms; /* 0 if the Flash does not say */
+	uint32_t max_ms;     /* 0 if the Flash does not say */
+	uint8_t opcode;
+	uint8_t opcode_4b; /* 0 if there is no 4-byte address form of this erase */
+} spi_erase_type_s;
+
 typedef struct spi_parameters {
 	uint32_t page_size;
 	uint32_t sector_size;
 	size_t capacity;
 	uint8_t sector_erase_opcode;
+	uint8_t address_modes;
+	uint8_t enter_4b_methods;
+	uint8_t page_program_opcode_4b;
+	/* Erase types in ascending size order, erase_types_count valid entries */
+	uint8_t erase_types_count;
+	spi_erase_type_s erase_types[SPI_FLASH_ERASE_TYPES];
+	spi_read_mode_s read_modes[SPI_READ_MODES];
 } spi_parameters_s;
 
 typedef void (*read_sfdp_func)(target_s *t, uint32_t address, void *buffer, size_t length);
 
 bool sfdp_read_parameters(target_s *t, spi_parameters_s *params, read_sfdp_func sfdp_read);
+spi_read_mode_id_e sfdp_fastest_read_mode(const spi_parameters_s *params, uint32_t usable_modes);
 
 #endif /* TARGET_SFDP_H */
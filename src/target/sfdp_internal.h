@@ -41,6 +41,7 @@
 
 #define SFDP_MAGIC                     "SFDP"
 #define SFDP_BASIC_SPI_PARAMETER_TABLE 0xff00U
+#define SFDP_4BYTE_INSTRUCTION_TABLE   0xff84U
 
 #define SFDP_ACCESS_PROTOCOL_LEGACY_JESD216B 0xffU
 
@@ -57,6 +58,38 @@
 #define SFDP_PAGE_SIZE(parameter_table) \
 	(1U << ((parameter_table).programming_and_chip_erase_timing.programming_timing_ratio_and_page_size >> 4U))
 
+/* DWORD 1, third byte: address bytes and which of the fast read modes are supported */
+#define SFDP_ADDRESS_BYTES(value2)   (((value2) >> 1U) & 3U)
+#define SFDP_ADDRESS_BYTES_3B        0U
+#define SFDP_ADDRESS_BYTES_3B_OR_4B  1U
+#define SFDP_ADDRESS_BYTES_4B        2U
+#define SFDP_SUPPORTS_FAST_1_1_2     (1U << 0U)
+#define SFDP_SUPPORTS_FAST_1_2_2     (1U << 4U)
+#define SFDP_SUPPORTS_FAST_1_4_4     (1U << 5U)
+#define SFDP_SUPPORTS_FAST_1_1_4     (1U << 6U)
+#define SFDP_READ_DUMMY_CLOCKS(mode) ((mode).timings & 0x1fU)
+#define SFDP_READ_MODE_CLOCKS(mode)  ((mode).timings >> 5U)
+
+/* DWORD 10: erase timings, typical time is (count + 1) * unit, maximum is 2 * (multiplier + 1) * typical */
+#define SFDP_ERASE_TIME_MULTIPLIER(erase_timing) (((erase_timing)&0x0fU) + 1U)
+#define SFDP_ERASE_TIME(erase_timing, type)      (((erase_timing) >> (4U + ((type)*7U))) & 0x7fU)
+#define SFDP_ERASE_TIME_COUNT(time)              (((time)&0x1fU) + 1U)
+#define SFDP_ERASE_TIME_UNIT(time)               ((time) >> 5U)
+
+/* DWORD 16: methods to enter 4-byte addressing */
+#define SFDP_ENTER_4B_METHODS(status_and_addressing_mode) ((status_and_addressing_mode) >> 24U)
+
+/* 4-byte address instruction table DWORD 1 support bits */
+#define SFDP_4B_READ_1_1_1        (1U << 0U)
+#define SFDP_4B_FAST_READ_1_1_1   (1U << 1U)
+#define SFDP_4B_FAST_READ_1_1_2   (1U << 2U)
+#define SFDP_4B_FAST_READ_1_2_2   (1U << 3U)
+#define SFDP_4B_FAST_READ_1_1_4   (1U << 4U)
+#define SFDP_4B_FAST_READ_1_4_4   (1U << 5U)
+#define SFDP_4B_PAGE_PROGRAM      (1U << 6U)
+#define SFDP_4B_ERASE_TYPE(type)  (1U << (9U + (type)))
+#define SFDP_4B_PAGE_PROGRAM_CMD  0x12U
+
 typedef struct sfdp_header {
 	char magic[4];
 	uint8_t version_minor;
@@ -120,4 +153,9 @@ typedef struct sfdp_basic_parameter_table {
 	uint32_t status_and_addressing_mode;
 } sfdp_basic_parameter_table_s;
 
+typedef struct sfdp_4byte_instruction_table {
+	uint32_t supported_instructions;
+	uint8_t erase_opcodes[SFDP_ERASE_TYPES];
+} sfdp_4byte_instruction_table_s;
+
 #endif /* TARGET_SFDP_INTERNAL_H */
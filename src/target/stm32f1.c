@@ -506,7 +506,7 @@ static inline void stm32f1_flash_clear_eop(target_s *const t, const uint32_t ban
 
 static bool stm32f1_flash_busy_wait(target_s *const t, const uint32_t bank_offset, platform_timeout_s *const timeout)
 {
-	/* Read FLASH_SR to poll for BSY bit */
+	/* Poll FLASH_SR on the probe for the BSY bit to clear */
 	uint32_t status = FLASH_SR_BSY;
 	/*
 	 * Please note that checking EOP here is only legal because every operation is preceded by
@@ -515,15 +515,22 @@ static bool stm32f1_flash_busy_wait(target_s *const t, const uint32_t bank_offse
 	 * For more information, see FLASH_SR register description §3.4 pg 25.
 	 * https://www.st.com/resource/en/programming_manual/pm0075-stm32f10xxx-flash-memory-microcontrollers-stmicroelectronics.pdf
 	 */
-	while (!(status & SR_EOP) && (status & FLASH_SR_BSY)) {
+	while (!target_mem_poll32(t, FLASH_SR + bank_offset, FLASH_SR_BSY, 0U, TARGET_POLL_SLICE)) {
 		status = target_mem_read32(t, FLASH_SR + bank_offset);
 		if (target_check_error(t)) {
 			DEBUG_WARN("Lost communications with target");
 			return false;
 		}
+		if (status & SR_EOP)
+			break;
 		if (timeout)
 			target_print_progress(timeout);
 	};
+	status = target_mem_read32(t, FLASH_SR + bank_offset);
+	if (target_check_error(t)) {
+		DEBUG_WARN("Lost communications with target");
+		return false;
+	}
 	if (status & SR_ERROR_MASK)
 		DEBUG_WARN("stm32f1 flash error 0x%" PRIx32 "\n", status);
 	return !(status & SR_ERROR_MASK);
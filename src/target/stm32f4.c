@@ -51,6 +51,7 @@ const command_s stm32f4_cmd_list[] = {
 static bool stm32f4_attach(target_s *t);
 static void stm32f4_detach(target_s *t);
 static bool stm32f4_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
+static bool stm32f4_flash_erase_wait(target_flash_s *f);
 static bool stm32f4_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
 static bool stm32f4_mass_erase(target_s *t);
 
@@ -155,6 +156,8 @@ static void stm32f4_add_flash(target_s *const t, const uint32_t addr, const size
 	f->length = length;
 	f->blocksize = blocksize;
 	f->erase = stm32f4_flash_erase;
+	f->erase_wait = stm32f4_flash_erase_wait;
+	f->erase_lazy = true;
 	f->write = stm32f4_flash_write;
 	f->writesize = 1024;
 	f->erased = 0xffU;
@@ -425,18 +428,24 @@ static void stm32f4_flash_unlock(target_s *t)
 
 static bool stm32f4_flash_busy_wait(target_s *const t, platform_timeout_s *const timeout)
 {
-	/* Read FLASH_SR to poll for BSY bit */
-	uint32_t status = FLASH_SR_BSY;
-	while (status & FLASH_SR_BSY) {
-		status = target_mem_read32(t, FLASH_SR);
-		if ((status & SR_ERROR_MASK) || target_check_error(t)) {
+	/*
+	 * Poll FLASH_SR on the probe for BSY to clear with no error bits set. Anything else ends the
+	 * poll's slice without a match, so the error bits are checked here between slices too.
+	 */
+	while (!target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY | SR_ERROR_MASK, 0U, TARGET_POLL_SLICE)) {
+		const uint32_t status = target_mem_read32(t, FLASH_SR);
+		if (target_check_error(t)) {
+			DEBUG_WARN("stm32f4 flash error: lost communications with target\n");
+			return false;
+		}
+		if (status & SR_ERROR_MASK) {
 			DEBUG_WARN("stm32f4 flash error 0x%" PRIx32 "\n", status);
 			return false;
 		}
 		if (timeout)
 			target_print_progress(timeout);
 	}
-	return true;
+	return !target_check_error(t);
 }
 
 static bool stm32f4_flash_erase(target_flash_s *f, target_addr_t addr, size_t len)
@@ -459,18 +468,21 @@ static bool stm32f4_flash_erase(target_flash_s *f, target_addr_t addr, size_t le
 	/* No address translation is needed here, as we erase by sector number */
 	uint8_t sector = sf->base_sector + ((addr - f->start) / f->blocksize);
 
-	/* Erase the requested chunk of flash, one sector at a time. */
+	/*
+	 * Erase the requested chunk of flash, one sector at a time. Each sector waits for whatever the controller
+	 * was doing before it, which might be an erase in another region, and the last is left running for
+	 * stm32f4_flash_erase_wait() so the probe can get on with other things in the meantime.
+	 */
 	for (size_t offset = 0; offset < len; offset += f->blocksize) {
+		if (!stm32f4_flash_busy_wait(t, NULL))
+			return false;
+
 		uint32_t cr = FLASH_CR_EOPIE | FLASH_CR_ERRIE | FLASH_CR_SER | (psize * FLASH_CR_PSIZE16) | (sector << 3U);
 		/* Flash page erase instruction */
 		target_mem_write32(t, FLASH_CR, cr);
 		/* write address to FMA */
 		target_mem_write32(t, FLASH_CR, cr | FLASH_CR_STRT);
 
-		/* Wait for completion or an error */
-		if (!stm32f4_flash_busy_wait(t, NULL))
-			return false;
-
 		++sector;
 		if (sf->bank_split && sector == sf->bank_split)
 			sector = 16;
@@ -478,6 +490,12 @@ static bool stm32f4_flash_erase(target_flash_s *f, target_addr_t addr, size_t le
 	return true;
 }
 
+static bool stm32f4_flash_erase_wait(target_flash_s *f)
+{
+	/* Wait for completion or an error */
+	return stm32f4_flash_busy_wait(f->t, NULL);
+}
+
 static bool stm32f4_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
 {
 	/* Translate ITCM addresses to AXIM */
@@ -485,6 +503,10 @@ static bool stm32f4_flash_write(target_flash_s *f, target_addr_t dest, const voi
 		dest += AXIM_BASE - ITCM_BASE;
 	target_s *t = f->t;
 
+	/* An erase left running for another region shares the controller with us */
+	if (!stm32f4_flash_busy_wait(t, NULL))
+		return false;
+
 	align_e psize = ((stm32f4_flash_s *)f)->psize;
 	target_mem_write32(t, FLASH_CR, (psize * FLASH_CR_PSIZE16) | FLASH_CR_PG);
 	cortexm_mem_write_sized(t, dest, src, len, psize);
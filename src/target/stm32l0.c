@@ -146,6 +146,16 @@
 #define STM32L0_DBGMCU_IDCODE_PHYS UINT32_C(0x40015800)
 #define STM32L1_DBGMCU_IDCODE_PHYS UINT32_C(0xe0042000)
 
+#define STM32Lx_SRAM_BASE        UINT32_C(0x20000000)
+#define STM32Lx_STUB_BUFFER_BASE ALIGN(STM32Lx_SRAM_BASE + sizeof(stm32lx_nvm_half_page_stub), 4)
+
+/* Program flash is written this many half pages at a time, by one run of the stub */
+#define STM32Lx_NVM_PROG_WRITE_HALF_PAGES 16U
+
+/* Data EEPROM words are buffered and written this many bytes at a time, with one error check for the lot */
+#define STM32Lx_NVM_EEPROM_WRITE_BLOCK 128U
+
+static bool stm32lx_nvm_prog_prepare(target_flash_s *f);
 static bool stm32lx_nvm_prog_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool stm32lx_nvm_prog_write(target_flash_s *f, target_addr_t dest, const void *src, size_t size);
 
@@ -155,6 +165,10 @@ static bool stm32lx_nvm_data_write(target_flash_s *f, target_addr_t dest, const
 static bool stm32lx_cmd_option(target_s *t, int argc, const char **argv);
 static bool stm32lx_cmd_eeprom(target_s *t, int argc, const char **argv);
 
+static const uint16_t stm32lx_nvm_half_page_stub[] = {
+#include "flashstub/stm32l0.stub"
+};
+
 static const command_s stm32lx_cmd_list[] = {
 	{"option", stm32lx_cmd_option, "Manipulate option bytes"},
 	{"eeprom", stm32lx_cmd_eeprom, "Manipulate EEPROM (NVM data) memory"},
@@ -208,9 +222,13 @@ static void stm32l_add_flash(target_s *t, uint32_t addr, size_t length, size_t e
 	f->start = addr;
 	f->length = length;
 	f->blocksize = erasesize;
+	f->prepare = stm32lx_nvm_prog_prepare;
 	f->erase = stm32lx_nvm_prog_erase;
 	f->write = stm32lx_nvm_prog_write;
+	/* Half pages are tracked individually, with runs of them handed to the stub in one go */
 	f->writesize = erasesize / 2U;
+	f->writebufsize = f->writesize * STM32Lx_NVM_PROG_WRITE_HALF_PAGES;
+	f->write_runs = true;
 	target_add_flash(t, f);
 }
 
@@ -227,6 +245,10 @@ static void stm32l_add_eeprom(target_s *t, uint32_t addr, size_t length)
 	f->blocksize = 4;
 	f->erase = stm32lx_nvm_data_erase;
 	f->write = stm32lx_nvm_data_write;
+	/* Words are still tracked individually so untouched EEPROM isn't rewritten, but written in bulk */
+	f->writesize = 4;
+	f->writebufsize = STM32Lx_NVM_EEPROM_WRITE_BLOCK;
+	f->write_runs = true;
 	target_add_flash(t, f);
 }
 
@@ -351,7 +373,17 @@ static bool stm32lx_nvm_prog_erase(target_flash_s *const f, const target_addr_t
 	return stm32lx_nvm_busy_wait(t, nvm);
 }
 
-/* Write to program flash using operations through the debug interface. */
+/* Load the half-page programming stub once for the whole flash operation, the writes just add their data */
+static bool stm32lx_nvm_prog_prepare(target_flash_s *const f)
+{
+	target_mem_write(f->t, STM32Lx_SRAM_BASE, stm32lx_nvm_half_page_stub, sizeof(stm32lx_nvm_half_page_stub));
+	return !target_check_error(f->t);
+}
+
+/*
+ * Write a run of half pages of program flash. The words have to reach the NVM back to back once half-page
+ * programming is enabled, so the stub in SRAM does the writes, waiting for the NVM to go idle after each.
+ */
 static bool stm32lx_nvm_prog_write(target_flash_s *f, target_addr_t dest, const void *src, size_t size)
 {
 	target_s *t = f->t;
@@ -367,14 +399,16 @@ static bool stm32lx_nvm_prog_write(target_flash_s *f, target_addr_t dest, const
 	if (!stm32lx_nvm_busy_wait(t, nvm))
 		return false;
 
+	target_mem_write(t, STM32Lx_STUB_BUFFER_BASE, src, size);
 	target_mem_write32(t, STM32Lx_NVM_PECR(nvm), STM32Lx_NVM_PECR_PROG | STM32Lx_NVM_PECR_FPRG);
-	target_mem_write(t, dest, src, size);
+	const bool stub_ok = !target_check_error(t) &&
+		cortexm_run_stub(t, STM32Lx_SRAM_BASE, dest, f->writesize, size, STM32Lx_NVM_SR(nvm)) == 0;
 
 	/* Disable further programming by locking PECR */
 	stm32lx_nvm_lock(t, nvm);
 
 	/* Wait for completion or an error */
-	return stm32lx_nvm_busy_wait(t, nvm);
+	return stm32lx_nvm_busy_wait(t, nvm) && stub_ok;
 }
 
 /*
@@ -410,7 +444,7 @@ static bool stm32lx_nvm_data_erase(target_flash_s *const f, const target_addr_t
 /*
  * Write to data flash using operations through the debug interface.
  * NVM register file address chosen from target.
- * Unaligned destination writes are supported (though unaligned sources are not).
+ * The buffered flash layer hands over runs of whole words, which go out as one bulk write.
  */
 static bool stm32lx_nvm_data_write(
 	target_flash_s *const f, const target_addr_t dest, const void *const src, const size_t size)
@@ -418,25 +452,23 @@ static bool stm32lx_nvm_data_write(
 	target_s *t = f->t;
 	const uint32_t nvm = stm32lx_nvm_phys(t);
 	const bool is_stm32l1 = stm32lx_is_stm32l1(t);
-	const uint32_t *const data = (const uint32_t *)src;
 
 	if (!stm32lx_nvm_prog_data_unlock(t, nvm))
 		return false;
 
 	target_mem_write32(t, STM32Lx_NVM_PECR(nvm), is_stm32l1 ? 0 : STM32Lx_NVM_PECR_DATA);
 
-	/* Sling data to the target one uint32_t at a time */
-	for (size_t offset = 0; offset < size; offset += 4U) {
-		/* XXX: Why is this not able to use target_mem_write()? */
-		target_mem_write32(t, dest + offset, data[offset]);
-		if (target_check_error(t))
-			return false;
-	}
+	/*
+	 * Each word write stalls the bus until the NVM is done with it, which the debug link rides out with
+	 * WAIT retries, so the whole run can go as one write with the error check after it.
+	 */
+	target_mem_write(t, dest, src, size);
+	const bool write_ok = !target_check_error(t);
 
 	/* Disable further programming by locking PECR */
 	stm32lx_nvm_lock(t, nvm);
 	/* Wait for completion or an error */
-	return stm32lx_nvm_busy_wait(t, nvm);
+	return stm32lx_nvm_busy_wait(t, nvm) && write_ok;
 }
 
 /*
@@ -58,9 +58,16 @@ static bool stm32l4_cmd_option(target_s *t, int argc, const char **argv);
 
 static bool stm32l4_attach(target_s *t);
 static void stm32l4_detach(target_s *t);
+static void stm32l4_reset(target_s *t);
 static bool stm32l4_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool stm32l4_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
+static bool stm32l4_flash_done(target_flash_s *f);
 static bool stm32l4_mass_erase(target_s *t);
+static bool stm32l4_cmd_erase(target_s *t, uint32_t action);
+
+static const uint16_t stm32l4_flash_fast_write_stub[] = {
+#include "flashstub/stm32l4.stub"
+};
 
 const command_s stm32l4_cmd_list[] = {
 	{"erase_bank1", stm32l4_cmd_erase_bank1, "Erase entire bank1 flash memory"},
@@ -113,6 +120,13 @@ const command_s stm32l4_cmd_list[] = {
 #define STM32L4_FLASH_BANK_1_BASE 0x08000000U
 #define FLASH_SIZE_MAX_G4_CAT4    (512U * 1024U) // 512kiB
 
+/* Fast programming writes rows of 32 double words, on parts organised as 2kiB pages of 64-bit words */
+#define STM32L4_FAST_ROW_SIZE  256U
+#define STM32L4_FAST_PAGE_SIZE 0x800U
+
+#define STM32L4_SRAM_BASE        0x20000000U
+#define STM32L4_STUB_BUFFER_BASE ALIGN(STM32L4_SRAM_BASE + sizeof(stm32l4_flash_fast_write_stub), 8)
+
 #define KEY1 0x45670123U
 #define KEY2 0xcdef89abU
 
@@ -194,6 +208,9 @@ typedef struct stm32l4_device_info {
 typedef struct stm32l4_flash {
 	target_flash_s f;
 	uint32_t bank1_start;
+	bool fast_program; /* Rows can be fast programmed (FSTPG) on this flash */
+	bool mass_erased;  /* The bank was mass erased and nothing written to it since, so it's still blank */
+	bool fast_writing; /* Rows are being fast programmed into the blank bank until the flash is done with */
 } stm32l4_flash_s;
 
 typedef struct stm32l4_priv {
@@ -477,9 +494,16 @@ static void stm32l4_add_flash(
 	f->blocksize = blocksize;
 	f->erase = stm32l4_flash_erase;
 	f->write = stm32l4_flash_write;
+	f->done = stm32l4_flash_done;
 	f->writesize = 2048;
 	f->erased = 0xffU;
 	sf->bank1_start = bank1_start;
+	/* L5 has no FSTPG, and its bank erase goes through the secure/non-secure register split */
+	const stm32l4_priv_s *const ps = (stm32l4_priv_s *)t->target_storage;
+	if (ps->device->family != STM32L4_FAMILY_L55x) {
+		f->erase_whole = true;
+		sf->fast_program = blocksize == STM32L4_FAST_PAGE_SIZE;
+	}
 	target_add_flash(t, f);
 }
 
@@ -560,6 +584,7 @@ bool stm32l4_probe(target_s *const t)
 	t->mass_erase = stm32l4_mass_erase;
 	t->attach = stm32l4_attach;
 	t->detach = stm32l4_detach;
+	t->reset = stm32l4_reset;
 	target_add_commands(t, stm32l4_cmd_list, device->designator);
 	return true;
 }
@@ -655,9 +680,26 @@ static bool stm32l4_attach(target_s *const t)
 	return true;
 }
 
+/* Once the target is running its own code again we can't know the flash is still blank */
+static void stm32l4_flash_forget_erased(target_s *const t)
+{
+	for (target_flash_s *f = t->flash; f; f = f->next) {
+		stm32l4_flash_s *const sf = (stm32l4_flash_s *)f;
+		sf->mass_erased = false;
+		sf->fast_writing = false;
+	}
+}
+
+static void stm32l4_reset(target_s *const t)
+{
+	stm32l4_flash_forget_erased(t);
+	cortexm_reset(t);
+}
+
 static void stm32l4_detach(target_s *const t)
 {
 	const stm32l4_priv_s *const ps = (stm32l4_priv_s *)t->target_storage;
+	stm32l4_flash_forget_erased(t);
 
 	/*reverse all changes to DBGMCU_CR*/
 	target_mem_write32(t, DBGMCU_CR(STM32L4_DBGMCU_IDCODE_PHYS), ps->dbgmcu_cr);
@@ -675,24 +717,46 @@ static void stm32l4_flash_unlock(target_s *const t)
 
 static bool stm32l4_flash_busy_wait(target_s *const t, platform_timeout_s *timeout)
 {
-	/* Read FLASH_SR to poll for BSY bit */
-	uint32_t status = FLASH_SR_BSY;
-	while (status & FLASH_SR_BSY) {
-		status = stm32l4_flash_read32(t, FLASH_SR);
-		if ((status & FLASH_SR_ERROR_MASK) || target_check_error(t)) {
-			DEBUG_WARN("stm32l4 Flash error: status 0x%" PRIx32 "\n", status);
+	const stm32l4_priv_s *const ps = (stm32l4_priv_s *)t->target_storage;
+	const uint32_t status_reg = ps->device->flash_regs_map[FLASH_SR];
+	/* Have the probe poll FLASH_SR for the BSY bit to clear */
+	while (!target_mem_poll32(t, status_reg, FLASH_SR_BSY, 0U, TARGET_POLL_SLICE)) {
+		if (target_check_error(t))
 			return false;
-		}
 		if (timeout)
 			target_print_progress(timeout);
 	}
+	const uint32_t status = stm32l4_flash_read32(t, FLASH_SR);
+	if ((status & FLASH_SR_ERROR_MASK) || target_check_error(t)) {
+		DEBUG_WARN("stm32l4 Flash error: status 0x%" PRIx32 "\n", status);
+		return false;
+	}
 	return true;
 }
 
+/* The mass erase bits covering a flash region, both banks if it spans them or the part has just one */
+static uint32_t stm32l4_flash_bank_erase_flags(const stm32l4_flash_s *const sf)
+{
+	if (sf->bank1_start == UINT32_MAX || sf->f.start + sf->f.length > sf->bank1_start)
+		return sf->f.start >= sf->bank1_start ? FLASH_CR_MER2 : FLASH_CR_MER1 | FLASH_CR_MER2;
+	return FLASH_CR_MER1;
+}
+
+/* Note which flash regions a mass or bank erase just blanked in full, so their rows can be fast programmed */
+static void stm32l4_flash_note_mass_erased(target_s *const t, const uint32_t action)
+{
+	for (target_flash_s *f = t->flash; f; f = f->next) {
+		stm32l4_flash_s *const sf = (stm32l4_flash_s *)f;
+		const uint32_t bank_flags = stm32l4_flash_bank_erase_flags(sf);
+		if (sf->fast_program && (bank_flags & action) == bank_flags)
+			sf->mass_erased = true;
+	}
+}
+
 static bool stm32l4_flash_erase(target_flash_s *const f, const target_addr_t addr, const size_t len)
 {
 	target_s *t = f->t;
-	const stm32l4_flash_s *const sf = (stm32l4_flash_s *)f;
+	stm32l4_flash_s *const sf = (stm32l4_flash_s *)f;
 	/* Unlock the Flash and wait for the operation to complete, reporting any errors */
 	stm32l4_flash_unlock(t);
 	if (!stm32l4_flash_busy_wait(t, NULL))
@@ -701,6 +765,20 @@ static bool stm32l4_flash_erase(target_flash_s *const f, const target_addr_t add
 	/* Fixme: OPTVER always set after reset! Wrong option defaults? */
 	stm32l4_flash_write32(t, FLASH_SR, stm32l4_flash_read32(t, FLASH_SR));
 
+	/* The generic code only hands over the whole region when asked to erase all of it, use a bank erase for that */
+	if (f->erase_whole && addr == f->start && len >= f->length) {
+		const uint32_t action = stm32l4_flash_bank_erase_flags(sf);
+		if (!stm32l4_cmd_erase(t, action))
+			return false;
+		stm32l4_flash_note_mass_erased(t, action);
+		return true;
+	}
+
+	/* Nothing has been written to the bank since it was mass erased, so its pages are still blank */
+	if (sf->mass_erased)
+		return true;
+	/* Rows fast programmed so far stay valid, but FSTPG is only for a bank that was mass erased */
+	sf->fast_writing = false;
 	/* Erase the requested chunk of flash, one page at a time. */
 	for (size_t offset = 0; offset < len; offset += f->blocksize) {
 		const uint32_t page = (addr + offset - STM32L4_FLASH_BANK_1_BASE) / f->blocksize;
@@ -718,9 +796,68 @@ static bool stm32l4_flash_erase(target_flash_s *const f, const target_addr_t add
 	return true;
 }
 
+/*
+ * Program whole rows with FSTPG. The controller wants each row's double words back to back, which the
+ * debug link can't promise, so the writes are done by a stub running from SRAM. On failure, written is
+ * set to how many bytes of whole rows the stub did program before it stopped.
+ */
+static bool stm32l4_flash_fast_write(
+	target_s *const t, const target_addr_t dest, const void *const src, const size_t len, size_t *const written)
+{
+	*written = 0;
+	const stm32l4_priv_s *const ps = (stm32l4_priv_s *)t->target_storage;
+	stm32l4_flash_unlock(t);
+	if (!stm32l4_flash_busy_wait(t, NULL))
+		return false;
+	/* Clear stale flags (OPTVERR is set after reset) so the stub only sees errors from its own rows */
+	stm32l4_flash_write32(t, FLASH_SR, stm32l4_flash_read32(t, FLASH_SR));
+
+	target_mem_write(t, STM32L4_SRAM_BASE, stm32l4_flash_fast_write_stub, sizeof(stm32l4_flash_fast_write_stub));
+	target_mem_write(t, STM32L4_STUB_BUFFER_BASE, src, len);
+	if (target_check_error(t))
+		return false;
+
+	const int result = cortexm_run_stub(
+		t, STM32L4_SRAM_BASE, dest, STM32L4_STUB_BUFFER_BASE, len, ps->device->flash_regs_map[FLASH_SR]);
+	if (result != 0) {
+		/* The stub only counts r2 down once a row has programmed cleanly, so it tells us how far it got */
+		uint32_t remaining = len;
+		target_reg_read(t, 2, &remaining, sizeof(remaining));
+		if (remaining <= len)
+			*written = (len - remaining) & ~(STM32L4_FAST_ROW_SIZE - 1U);
+		DEBUG_WARN("stm32l4 fast programming failed at 0x%08" PRIx32 ", status 0x%" PRIx32 "\n",
+			(uint32_t)(dest + *written), stm32l4_flash_read32(t, FLASH_SR));
+		return false;
+	}
+	return true;
+}
+
 static bool stm32l4_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
 {
 	target_s *t = f->t;
+	stm32l4_flash_s *const sf = (stm32l4_flash_s *)f;
+	const bool fast = sf->mass_erased || sf->fast_writing;
+	/* Whichever way this is programmed, the bank is no longer blank */
+	sf->mass_erased = false;
+	if (fast && !(dest % STM32L4_FAST_ROW_SIZE) && !(len % STM32L4_FAST_ROW_SIZE)) {
+		size_t written = 0;
+		sf->fast_writing = true;
+		if (stm32l4_flash_fast_write(t, dest, src, len, &written))
+			return true;
+		/*
+		 * The controller refuses fast programming (PGSERR) unless the bank really is blank, e.g. if something
+		 * else wrote to it since the erase we saw. Stop trying and program normally from here on, starting
+		 * with the row the stub stopped on as the ones before it are already programmed.
+		 */
+		sf->fast_writing = false;
+		stm32l4_flash_write32(t, FLASH_SR, stm32l4_flash_read32(t, FLASH_SR));
+		dest += written;
+		src = (const uint8_t *)src + written;
+		len -= written;
+	}
+	/* Once rows have been programmed normally, stick to that until the bank is mass erased again */
+	sf->fast_writing = false;
+
 	stm32l4_flash_write32(t, FLASH_CR, FLASH_CR_PG);
 	target_mem_write(t, dest, src, len);
 
@@ -728,6 +865,14 @@ static bool stm32l4_flash_write(target_flash_s *f, target_addr_t dest, const voi
 	return stm32l4_flash_busy_wait(t, NULL);
 }
 
+/* A bank left untouched stays blank for the next session, but one that's been written needs erasing again */
+static bool stm32l4_flash_done(target_flash_s *const f)
+{
+	stm32l4_flash_s *const sf = (stm32l4_flash_s *)f;
+	sf->fast_writing = false;
+	return true;
+}
+
 static bool stm32l4_cmd_erase(target_s *const t, const uint32_t action)
 {
 	stm32l4_flash_unlock(t);
@@ -744,7 +889,10 @@ static bool stm32l4_cmd_erase(target_s *const t, const uint32_t action)
 
 static bool stm32l4_mass_erase(target_s *const t)
 {
-	return stm32l4_cmd_erase(t, FLASH_CR_MER1 | FLASH_CR_MER2);
+	if (!stm32l4_cmd_erase(t, FLASH_CR_MER1 | FLASH_CR_MER2))
+		return false;
+	stm32l4_flash_note_mass_erased(t, FLASH_CR_MER1 | FLASH_CR_MER2);
+	return true;
 }
 
 static bool stm32l4_cmd_erase_bank1(target_s *const t, const int argc, const char **const argv)
@@ -753,6 +901,8 @@ static bool stm32l4_cmd_erase_bank1(target_s *const t, const int argc, const cha
 	(void)argv;
 	gdb_out("Erasing bank 1: ");
 	const bool result = stm32l4_cmd_erase(t, FLASH_CR_MER1);
+	if (result)
+		stm32l4_flash_note_mass_erased(t, FLASH_CR_MER1);
 	gdb_out("done\n");
 	return result;
 }
@@ -763,6 +913,8 @@ static bool stm32l4_cmd_erase_bank2(target_s *const t, const int argc, const cha
 	(void)argv;
 	gdb_out("Erasing bank 2: ");
 	const bool result = stm32l4_cmd_erase(t, FLASH_CR_MER2);
+	if (result)
+		stm32l4_flash_note_mass_erased(t, FLASH_CR_MER2);
 	gdb_out("done\n");
 	return result;
 }
@@ -29,6 +29,9 @@ target_s *target_list = NULL;
 
 #define STDOUT_READ_BUF_SIZE 64
 
+/* Lowest frequency target_swj_frequency_tune() steps down to looking for one the link works at */
+#define SWJ_TUNE_MIN_FREQUENCY 10000U
+
 static bool target_cmd_mass_erase(target_s *t, int argc, const char **argv);
 static bool target_cmd_range_erase(target_s *t, int argc, const char **argv);
 
@@ -249,6 +252,23 @@ bool target_check_error(target_s *t)
 	return false;
 }
 
+void target_defer_error_check(target_s *t)
+{
+	++t->error_check_deferred;
+}
+
+bool target_sync_error_check(target_s *t)
+{
+	if (t->error_check_deferred && --t->error_check_deferred)
+		return false;
+	t->fault_addr = UINT32_MAX;
+	if (!target_check_error(t))
+		return false;
+	if (t->fault_addr != UINT32_MAX)
+		DEBUG_WARN("Deferred access fault at 0x%08" PRIx32 "\n", t->fault_addr);
+	return true;
+}
+
 bool target_attached(target_s *t)
 {
 	return t->attached;
@@ -259,6 +279,8 @@ int target_mem_read(target_s *t, void *dest, target_addr_t src, size_t len)
 {
 	if (t->mem_read)
 		t->mem_read(t, dest, src, len);
+	if (t->error_check_deferred)
+		return 0;
 	return target_check_error(t);
 }
 
@@ -266,6 +288,8 @@ int target_mem_write(target_s *t, target_addr_t dest, const void *src, size_t le
 {
 	if (t->mem_write)
 		t->mem_write(t, dest, src, len);
+	if (t->error_check_deferred)
+		return 0;
 	return target_check_error(t);
 }
 
@@ -322,6 +346,9 @@ void target_reset(target_s *t)
 
 void target_halt_request(target_s *t)
 {
+	/* An explicit halt request ends any range step, so the halt gets reported */
+	t->step_range_end = 0;
+	t->halt_requested = true;
 	if (t->halt_request)
 		t->halt_request(t);
 }
@@ -334,12 +361,46 @@ target_halt_reason_e target_halt_poll(target_s *t, target_addr_t *watch)
 	return TARGET_HALT_RUNNING;
 }
 
+/*
+ * Wait up to timeout ms for a running target to halt, returning early if it does. The result still
+ * has to be picked up with target_halt_poll(). Returns false, without waiting, if the target can't
+ * do this, in which case the caller should pace its polling itself.
+ */
+bool target_halt_wait(target_s *t, uint32_t timeout)
+{
+	if (!t->halt_wait)
+		return false;
+	return t->halt_wait(t, timeout);
+}
+
 void target_halt_resume(target_s *t, bool step)
 {
+	t->step_range_start = 0;
+	t->step_range_end = 0;
+	t->halt_requested = false;
 	if (t->halt_resume)
 		t->halt_resume(t, step);
 }
 
+/*
+ * Single step, and have the target driver keep stepping on our side while the PC stays within
+ * [range_start, range_end). Drivers that don't support this just stop after the first step.
+ */
+void target_halt_resume_range(target_s *t, target_addr_t range_start, target_addr_t range_end)
+{
+	t->step_range_start = range_start;
+	t->step_range_end = range_end;
+	t->halt_requested = false;
+	if (t->halt_resume)
+		t->halt_resume(t, true);
+}
+
+/* Whether the target driver is still stepping through a range set by target_halt_resume_range() */
+bool target_halt_range_stepping(target_s *t)
+{
+	return t->step_range_end != 0;
+}
+
 /* Command line for semihosting get_cmdline */
 void target_set_cmdline(target_s *t, char *cmdline)
 {
@@ -446,6 +507,75 @@ static bool target_cmd_range_erase(target_s *const t, const int argc, const char
 	return target_flash_erase(t, addr, length);
 }
 
+/* Frequency target_swj_frequency_tune() last settled on, 0 if it's not in use */
+static uint32_t swj_tuned_frequency = 0;
+
+/*
+ * Find the highest SWJ frequency at which the target's link test passes. If the link fails at the
+ * frequency we start from, step down until it works, otherwise double the frequency until it fails
+ * or the interface can go no faster. Then bisect down on the point where it broke. Returns the
+ * frequency settled on, or 0 if the link can't be tested or fails even at the lowest frequency.
+ */
+uint32_t target_swj_frequency_tune(target_s *t)
+{
+	swj_tuned_frequency = 0;
+	uint32_t good = platform_max_frequency_get();
+	if (good == FREQ_FIXED || !t->link_test)
+		return 0;
+
+	uint32_t bad = 0;
+	while (!t->link_test(t)) {
+		bad = good;
+		platform_max_frequency_set(good / 2U);
+		good = platform_max_frequency_get();
+		/* Give up once the interface can't go any slower */
+		if (good >= bad || good < SWJ_TUNE_MIN_FREQUENCY)
+			return 0;
+	}
+
+	while (!bad && good <= UINT32_MAX / 2U) {
+		platform_max_frequency_set(good * 2U);
+		const uint32_t freq = platform_max_frequency_get();
+		/* Stop once the interface can't go any faster */
+		if (freq <= good)
+			break;
+		if (t->link_test(t))
+			good = freq;
+		else
+			bad = freq;
+	}
+
+	/* Narrow in to within 1/8th of the frequency the link broke at */
+	while (bad && bad - good > good / 8U) {
+		platform_max_frequency_set(good + (bad - good) / 2U);
+		const uint32_t freq = platform_max_frequency_get();
+		if (freq <= good || freq >= bad)
+			break;
+		if (t->link_test(t))
+			good = freq;
+		else
+			bad = freq;
+	}
+
+	platform_max_frequency_set(good);
+	/* Run the test one more time to recover the link from any failure at a higher frequency */
+	if (!t->link_test(t))
+		return 0;
+	swj_tuned_frequency = platform_max_frequency_get();
+	return swj_tuned_frequency;
+}
+
+void target_swj_frequency_backoff(void)
+{
+	/* Leave the frequency alone if it wasn't tuned, or has been set by hand since */
+	const uint32_t freq = platform_max_frequency_get();
+	if (!swj_tuned_frequency || freq != swj_tuned_frequency)
+		return;
+	platform_max_frequency_set(freq - freq / 4U);
+	swj_tuned_frequency = platform_max_frequency_get();
+	DEBUG_WARN("SWJ link errors, backing off to %" PRIu32 "Hz\n", swj_tuned_frequency);
+}
+
 /* Accessor functions */
 size_t target_regs_size(target_s *t)
 {
@@ -492,6 +622,19 @@ uint32_t target_mem_read32(target_s *t, uint32_t addr)
 	return result;
 }
 
+bool target_mem_poll32(target_s *t, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout)
+{
+	if (t->mem_poll32)
+		return t->mem_poll32(t, addr, mask, value, timeout);
+	platform_timeout_s poll_timeout;
+	platform_timeout_set(&poll_timeout, timeout);
+	while ((target_mem_read32(t, addr) & mask) != value) {
+		if (platform_timeout_is_expired(&poll_timeout))
+			return false;
+	}
+	return true;
+}
+
 void target_mem_write32(target_s *t, uint32_t addr, uint32_t value)
 {
 	if (t->mem_write)
@@ -71,6 +71,12 @@ static bool target_exit_flash_mode(target_s *t)
 	if (!t->flash_mode)
 		return true;
 
+	/* What was erased is only known for as long as we hold the flash */
+	for (target_flash_s *f = t->flash; f; f = f->next) {
+		memset(f->erased_range, 0, sizeof(f->erased_range));
+		memset(f->erase_pending, 0, sizeof(f->erase_pending));
+	}
+
 	bool ret = true;
 	if (t->exit_flash_mode)
 		ret = t->exit_flash_mode(t);
@@ -98,26 +104,171 @@ static bool flash_prepare(target_flash_s *f)
 	return ret;
 }
 
-static bool flash_done(target_flash_s *f)
+/* Wait out an erase the driver left running so the flash can be used again */
+static bool flash_erase_wait(target_flash_s *f)
 {
-	if (!f->ready)
+	/* An erase that was already waited out by target_flash_erase_wait() fails whatever uses the flash next */
+	bool ret = !f->erase_failed;
+	f->erase_failed = false;
+	if (!f->erase_busy)
+		return ret;
+	f->erase_busy = false;
+
+	target_defer_error_check(f->t);
+	ret &= f->erase_wait(f);
+	ret &= !target_sync_error_check(f->t);
+	return ret;
+}
+
+/*
+ * Wait out any erase left running between flash operations, so the target can be safely accessed. A failure is
+ * held over to the next flash operation, as that is what gets reported back to the user.
+ */
+void target_flash_erase_wait(target_s *t)
+{
+	for (target_flash_s *f = t->flash; f; f = f->next) {
+		if (f->erase_busy)
+			f->erase_failed = !flash_erase_wait(f);
+	}
+}
+
+/* Add a block to a set of ranges, returning false if there's no room left to track it */
+static bool flash_range_add(target_flash_range_s *ranges, target_addr_t start, target_addr_t end)
+{
+	for (size_t idx = 0; idx < FLASH_ERASED_RANGES; ++idx) {
+		target_flash_range_s *const range = &ranges[idx];
+		/* Grow a range this block overlaps or abuts */
+		if (range->start != range->end && start <= range->end && end >= range->start) {
+			range->start = MIN(range->start, start);
+			range->end = MAX(range->end, end);
+			return true;
+		}
+	}
+	for (size_t idx = 0; idx < FLASH_ERASED_RANGES; ++idx) {
+		target_flash_range_s *const range = &ranges[idx];
+		if (range->start == range->end) {
+			range->start = start;
+			range->end = end;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Remember that a block was erased so writes of the erased value to it can be skipped */
+static void flash_note_erased(target_flash_s *f, target_addr_t start, target_addr_t end)
+{
+	/* Out of ranges to track with, writes to this block just won't get the benefit of skipping */
+	if (!f->write_erases)
+		flash_range_add(f->erased_range, start, end);
+}
+
+static bool flash_is_erased(target_flash_s *f, target_addr_t start, target_addr_t end)
+{
+	for (size_t idx = 0; idx < FLASH_ERASED_RANGES; ++idx) {
+		if (f->erased_range[idx].start <= start && end <= f->erased_range[idx].end)
+			return true;
+	}
+	return false;
+}
+
+static bool flash_unit_is_erased_value(target_flash_s *f, const uint8_t *data)
+{
+	for (size_t offset = 0; offset < f->writesize; ++offset) {
+		if (data[offset] != f->erased)
+			return false;
+	}
+	return true;
+}
+
+/* Run a single erase call on the flash, which a driver with erase_wait may leave running on return */
+static bool flash_erase_block(target_flash_s *f, target_addr_t start, target_addr_t end)
+{
+	if (!flash_prepare(f) || !flash_erase_wait(f))
+		return false;
+
+	/* Check the sticky error flags once per block rather than after each access the driver makes */
+	target_defer_error_check(f->t);
+	bool ret = f->erase(f, start, end - start);
+	ret &= !target_sync_error_check(f->t);
+	if (!ret) {
+		DEBUG_WARN("Erase failed at %" PRIx32 "\n", start);
+		return false;
+	}
+	f->erase_busy = f->erase_wait != NULL;
+	flash_note_erased(f, start, end);
+	return true;
+}
+
+/* Erase the scheduled blocks overlapping start to end, ahead of them being written */
+static bool flash_erase_pending(target_flash_s *f, target_addr_t start, target_addr_t end)
+{
+	for (size_t idx = 0; idx < FLASH_ERASED_RANGES; ++idx) {
+		target_flash_range_s *const range = &f->erase_pending[idx];
+		while (range->start != range->end && range->start < end && start < range->end) {
+			const target_addr_t block = range->start;
+			range->start += f->blocksize;
+			if (!flash_erase_block(f, block, block + f->blocksize))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Start erasing the lowest scheduled block if the driver can do so in the background,
+ * so it proceeds while the host sends the data for it.
+ */
+static bool flash_erase_ahead(target_flash_s *f)
+{
+	if (!f->erase_wait || f->erase_busy)
 		return true;
 
-	bool ret = true;
+	target_flash_range_s *next = NULL;
+	for (size_t idx = 0; idx < FLASH_ERASED_RANGES; ++idx) {
+		target_flash_range_s *const range = &f->erase_pending[idx];
+		if (range->start != range->end && (!next || range->start < next->start))
+			next = range;
+	}
+	if (!next)
+		return true;
+
+	const target_addr_t block = next->start;
+	next->start += f->blocksize;
+	return flash_erase_block(f, block, block + f->blocksize);
+}
+
+/* Finish with the flash for now, leaving any blocks still scheduled for erase until it's next used */
+static bool flash_release(target_flash_s *f)
+{
+	bool ret = flash_erase_wait(f);
+	if (!f->ready)
+		return ret;
+
 	if (f->done)
-		ret = f->done(f);
+		ret &= f->done(f);
+
+	f->ready = false;
+
+	return ret;
+}
+
+static bool flash_done(target_flash_s *f)
+{
+	/* Blocks scheduled for erase have to be erased by the end of the session, written to or not */
+	bool ret = flash_erase_pending(f, 0U, UINT32_MAX);
+	memset(f->erase_pending, 0, sizeof(f->erase_pending));
+	ret &= flash_release(f);
 
 	if (f->buf) {
 		free(f->buf);
 		f->buf = NULL;
 	}
 
-	f->ready = false;
-
 	return ret;
 }
 
-bool target_flash_erase(target_s *t, target_addr_t addr, size_t len)
+static bool flash_erase_request(target_s *t, target_addr_t addr, size_t len, const bool lazy)
 {
 	if (!target_enter_flash_mode(t))
 		return false;
@@ -134,69 +285,198 @@ bool target_flash_erase(target_s *t, target_addr_t addr, size_t len)
 			return false;
 		}
 
-		/* Terminate flash operations if we're not in the same target flash */
+		/* Terminate flash operations if we're not in the same target flash, keeping its scheduled erases */
 		if (f != active_flash) {
-			ret &= flash_done(active_flash);
+			ret &= lazy ? flash_release(active_flash) : flash_done(active_flash);
 			active_flash = f;
 		}
 
 		const target_addr_t local_start_addr = addr & ~(f->blocksize - 1U);
-		const target_addr_t local_end_addr = local_start_addr + f->blocksize;
-
-		if (!flash_prepare(f))
-			return false;
-
-		ret &= f->erase(f, local_start_addr, f->blocksize);
-		if (!ret) {
-			DEBUG_WARN("Erase failed at %" PRIx32 "\n", local_start_addr);
+		target_addr_t local_end_addr = local_start_addr + f->blocksize;
+		/* Drivers with a block erase command get the whole flash in one call when the request covers all of it */
+		if (f->erase_whole && local_start_addr == f->start && len >= f->length - (addr - f->start))
+			local_end_addr = f->start + f->length;
+
+		/* Single blocks of lazily erased flash are scheduled, falling back to erasing now if that can't be tracked */
+		if (!lazy || !f->erase_lazy || local_end_addr - local_start_addr != f->blocksize ||
+			!flash_range_add(f->erase_pending, local_start_addr, local_end_addr))
+			ret &= flash_erase_block(f, local_start_addr, local_end_addr);
+		if (!ret)
 			break;
-		}
 
 		len -= MIN(local_end_addr - addr, len);
 		addr = local_end_addr;
 	}
 	/* Issue flash done on last operation */
-	ret &= flash_done(active_flash);
+	if (!lazy)
+		ret &= flash_done(active_flash);
+	else if (!active_flash->erase_lazy)
+		ret &= flash_release(active_flash);
+	else if (ret)
+		ret &= flash_erase_ahead(active_flash);
 	return ret;
 }
 
+bool target_flash_erase(target_s *t, target_addr_t addr, size_t len)
+{
+	return flash_erase_request(t, addr, len, false);
+}
+
+/*
+ * Like target_flash_erase(), but flash that supports it has its blocks erased only as they're first written,
+ * overlapping erase with the transfer of the data where the driver can. Anything not written by the time
+ * target_flash_complete() is called gets erased then, so that must always follow.
+ */
+bool target_flash_erase_lazy(target_s *t, target_addr_t addr, size_t len)
+{
+	return flash_erase_request(t, addr, len, true);
+}
+
+/* Number of 32-bit words in a buffer slot's dirty bitmap, one bit per writesize unit */
+static size_t flash_dirty_words(const target_flash_s *f)
+{
+	return (f->writebufsize / f->writesize + 31U) / 32U;
+}
+
+static bool flash_unit_is_dirty(const uint32_t *dirty, size_t unit)
+{
+	return dirty[unit / 32U] & (1U << (unit % 32U));
+}
+
 bool flash_buffer_alloc(target_flash_s *flash)
 {
-	/* Allocate buffer */
-	flash->buf = malloc(flash->writebufsize);
+	/* Each slot's dirty bitmap lives after the data, so it is freed along with it */
+	const size_t buf_size = ALIGN(flash->writebufsize, 4U);
+	const size_t dirty_size = flash_dirty_words(flash) * sizeof(uint32_t);
+	/* Allocate buffer, settling for fewer slots if the heap can't fit them all */
+	for (size_t slots = FLASH_BUFFER_SLOTS; slots && !flash->buf; --slots) {
+		flash->buf = malloc((buf_size + dirty_size) * slots);
+		flash->buf_slots = slots;
+	}
 	if (!flash->buf) { /* malloc failed: heap exhaustion */
 		DEBUG_WARN("malloc: failed in %s\n", __func__);
 		return false;
 	}
-	flash->buf_addr_base = UINT32_MAX;
-	flash->buf_addr_low = UINT32_MAX;
-	flash->buf_addr_high = 0;
+	uint32_t *const dirty = (uint32_t *)((uint8_t *)flash->buf + buf_size * flash->buf_slots);
+	memset(dirty, 0, dirty_size * flash->buf_slots);
+	for (size_t slot = 0; slot < FLASH_BUFFER_SLOTS; ++slot) {
+		flash->buf_slot[slot].addr = UINT32_MAX;
+		flash->buf_slot[slot].dirty = slot < flash->buf_slots ? dirty + slot * flash_dirty_words(flash) : NULL;
+		flash->buf_slot[slot].age = 0;
+	}
+	flash->buf_age = 0;
 	return true;
 }
 
-static bool flash_buffered_flush(target_flash_s *f)
+static bool flash_buffered_program(target_flash_s *f, target_addr_t base_addr, const uint8_t *src, uint32_t *dirty)
 {
+	/* Blocks scheduled for erase get erased just before they're first written */
+	if (!flash_erase_pending(f, base_addr, base_addr + f->writebufsize))
+		return false;
+
+	/* Units holding only the erased value need no programming if their block was erased this session */
+	const size_t units = f->writebufsize / f->writesize;
+	bool any_dirty = false;
+	for (size_t unit = 0; unit < units; ++unit) {
+		const size_t offset = unit * f->writesize;
+		if (flash_unit_is_dirty(dirty, unit) && flash_unit_is_erased_value(f, src + offset) &&
+			flash_is_erased(f, base_addr + offset, base_addr + offset + f->writesize))
+			dirty[unit / 32U] &= ~(1U << (unit % 32U));
+		any_dirty |= flash_unit_is_dirty(dirty, unit);
+	}
+	if (!any_dirty)
+		return true;
+
+	if (!flash_prepare(f) || !flash_erase_wait(f))
+		return false;
+
+	/* Write buffer to flash, programming only the write units that were actually written to */
 	bool ret = true; /* Catch false returns with &= */
-	if (f->buf && f->buf_addr_base != UINT32_MAX && f->buf_addr_low != UINT32_MAX &&
-		f->buf_addr_low < f->buf_addr_high) {
-		/* Write buffer to flash */
+	/* Check the sticky error flags once per block rather than after each access the driver makes */
+	target_defer_error_check(f->t);
+	for (size_t unit = 0; unit < units;) {
+		if (!flash_unit_is_dirty(dirty, unit)) {
+			++unit;
+			continue;
+		}
+		/* Drivers that can take them get each run of dirty units in one call */
+		size_t run = 1U;
+		while (f->write_runs && unit + run < units && flash_unit_is_dirty(dirty, unit + run))
+			++run;
+		const size_t offset = unit * f->writesize;
+		ret &= f->write(f, base_addr + offset, src + offset, run * f->writesize);
+		unit += run;
+	}
+	ret &= !target_sync_error_check(f->t);
+	/* Having finished a block, get the next scheduled one erasing while its data is on the way */
+	if (ret && !((base_addr + f->writebufsize) & (f->blocksize - 1U)))
+		ret &= flash_erase_ahead(f);
+	return ret;
+}
 
-		if (!flash_prepare(f))
-			return false;
+static bool flash_buffered_flush_slot(target_flash_s *f, size_t slot)
+{
+	target_flash_buf_s *const buf = &f->buf_slot[slot];
+	const target_addr_t base_addr = buf->addr;
 
-		target_addr_t aligned_addr = f->buf_addr_low & ~(f->writesize - 1U);
+	/* Release the slot up front so it's reusable even if the write fails */
+	buf->addr = UINT32_MAX;
+	buf->age = 0;
+	if (base_addr == UINT32_MAX)
+		return true;
 
-		const uint8_t *src = f->buf + (aligned_addr - f->buf_addr_base);
-		uint32_t len = f->buf_addr_high - aligned_addr;
+	const uint8_t *const src = (const uint8_t *)f->buf + slot * ALIGN(f->writebufsize, 4U);
+	const bool ret = flash_buffered_program(f, base_addr, src, buf->dirty);
+	memset(buf->dirty, 0, flash_dirty_words(f) * sizeof(uint32_t));
+	return ret;
+}
 
-		for (size_t offset = 0; offset < len; offset += f->writesize)
-			ret &= f->write(f, aligned_addr + offset, src + offset, f->writesize);
+static bool flash_buffered_flush(target_flash_s *f)
+{
+	if (!f->buf)
+		return true;
 
-		f->buf_addr_base = UINT32_MAX;
-		f->buf_addr_low = UINT32_MAX;
-		f->buf_addr_high = 0;
+	bool ret = true; /* Catch false returns with &= */
+	/* Write the cached blocks back in ascending address order */
+	while (true) {
+		size_t next = f->buf_slots;
+		for (size_t slot = 0; slot < f->buf_slots; ++slot) {
+			const target_addr_t addr = f->buf_slot[slot].addr;
+			if (addr != UINT32_MAX && (next == f->buf_slots || addr < f->buf_slot[next].addr))
+				next = slot;
+		}
+		if (next == f->buf_slots)
+			break;
+		ret &= flash_buffered_flush_slot(f, next);
+	}
+	return ret;
+}
+
+/*
+ * Find the buffer slot caching the block at base_addr. If the block isn't cached,
+ * the least recently used slot is written back and reused for it.
+ */
+static bool flash_buffer_slot(target_flash_s *f, target_addr_t base_addr, size_t *slot)
+{
+	size_t victim = 0;
+	for (size_t idx = 0; idx < f->buf_slots; ++idx) {
+		if (f->buf_slot[idx].addr == base_addr) {
+			f->buf_slot[idx].age = ++f->buf_age;
+			*slot = idx;
+			return true;
+		}
+		/* Unused slots have an age of 0 so are always picked first */
+		if (f->buf_slot[idx].age < f->buf_slot[victim].age)
+			victim = idx;
 	}
 
+	const bool ret = flash_buffered_flush_slot(f, victim);
+
+	/* Setup buffer */
+	f->buf_slot[victim].addr = base_addr;
+	f->buf_slot[victim].age = ++f->buf_age;
+	memset((uint8_t *)f->buf + victim * ALIGN(f->writebufsize, 4U), f->erased, f->writebufsize);
+	*slot = victim;
 	return ret;
 }
 
@@ -206,24 +486,19 @@ static bool flash_buffered_write(target_flash_s *f, target_addr_t dest, const vo
 	while (len) {
 		const target_addr_t base_addr = dest & ~(f->writebufsize - 1U);
 
-		/* Check for base address change */
-		if (base_addr != f->buf_addr_base) {
-			ret &= flash_buffered_flush(f);
-
-			/* Setup buffer */
-			f->buf_addr_base = base_addr;
-			memset(f->buf, f->erased, f->writebufsize);
-		}
+		size_t slot = 0;
+		ret &= flash_buffer_slot(f, base_addr, &slot);
 
 		const size_t offset = dest % f->writebufsize;
 		const size_t local_len = MIN(f->writebufsize - offset, len);
 
 		/* Copy chunk into sector buffer */
-		memcpy(f->buf + offset, src, local_len);
+		memcpy((uint8_t *)f->buf + slot * ALIGN(f->writebufsize, 4U) + offset, src, local_len);
 
-		/* This allows for writes smaller than writebufsize when flushing in the future */
-		f->buf_addr_low = MIN(f->buf_addr_low, dest);
-		f->buf_addr_high = MAX(f->buf_addr_high, dest + local_len);
+		/* Mark the write units this chunk touches, any others in the block are left alone on flush */
+		const size_t last_unit = (offset + local_len - 1U) / f->writesize;
+		for (size_t unit = offset / f->writesize; unit <= last_unit; ++unit)
+			f->buf_slot[slot].dirty[unit / 32U] |= 1U << (unit % 32U);
 
 		dest += local_len;
 		src += local_len;
@@ -246,7 +521,9 @@ bool target_flash_write(target_s *t, target_addr_t dest, const void *src, size_t
 		else if (f->buf) {
 			ret &= flash_buffered_flush(f);
 			ret &= flash_done(f);
-		}
+		} else
+			/* Only one flash at a time is kept prepared, they may share a controller or algorithm */
+			ret &= flash_release(f);
 	}
 	if (!active_flash || !ret)
 		return false;
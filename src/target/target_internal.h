@@ -38,11 +38,37 @@ struct target_ram {
 };
 
 typedef struct target_flash target_flash_s;
+typedef struct target_flash_buf target_flash_buf_s;
+
+/*
+ * Number of writebufsize blocks the buffered flash writer caches at once.
+ * Keep this small on the firmware where the heap is tight.
+ */
+#if PC_HOSTED == 1
+#define FLASH_BUFFER_SLOTS 8U
+#else
+#define FLASH_BUFFER_SLOTS 2U
+#endif
+
+/* Number of distinct address ranges remembered as erased, or still to erase, during a flash session */
+#define FLASH_ERASED_RANGES 4U
+
+typedef struct target_flash_range {
+	target_addr_t start; /* First address of the range */
+	target_addr_t end;   /* First address after the range, equal to start if unused */
+} target_flash_range_s;
 
 typedef bool (*flash_prepare_func)(target_flash_s *f);
 typedef bool (*flash_erase_func)(target_flash_s *f, target_addr_t addr, size_t len);
 typedef bool (*flash_write_func)(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
 typedef bool (*flash_done_func)(target_flash_s *f);
+typedef bool (*flash_wait_func)(target_flash_s *f);
+
+struct target_flash_buf {
+	target_addr_t addr; /* Address of block this buffer slot is for, UINT32_MAX if unused */
+	uint32_t *dirty;    /* Bitmap of writesize units in the slot that need programming, stored after the buffer */
+	uint32_t age;       /* Use stamp for least-recently-used slot replacement */
+};
 
 struct target_flash {
 	target_s *t;                 /* Target this flash is attached to */
@@ -50,17 +76,26 @@ struct target_flash {
 	size_t length;               /* Flash length */
 	size_t blocksize;            /* Erase block size */
 	size_t writesize;            /* Write operation size, must be <= blocksize/writebufsize */
-	size_t writebufsize;         /* Size of write buffer */
+	size_t writebufsize;         /* Size of write buffer, a multiple of writesize */
 	uint8_t erased;              /* Byte erased state */
 	bool ready;                  /* True if flash is in flash mode/prepared */
+	bool write_erases;           /* True if erase is a no-op and write erases each page itself */
+	bool erase_whole;            /* True if erase takes the whole flash in one call when a request covers it */
+	bool write_runs;             /* True if write takes a run of consecutive dirty writesize units in one call */
+	bool erase_lazy;             /* True if target_flash_erase_lazy() leaves blocks to be erased as first written */
+	bool erase_busy;             /* True while an erase left running by erase hasn't been waited for */
+	bool erase_failed;           /* True if target_flash_erase_wait() saw an erase fail, for the next use to report */
 	flash_prepare_func prepare;  /* Prepare for flash operations */
 	flash_erase_func erase;      /* Erase a range of flash */
+	flash_wait_func erase_wait;  /* If set, erase may return with the erase still running, this waits it out */
 	flash_write_func write;      /* Write to flash */
 	flash_done_func done;        /* Finish flash operations */
-	void *buf;                   /* Buffer for flash operations */
-	target_addr_t buf_addr_base; /* Address of block this buffer is for */
-	target_addr_t buf_addr_low;  /* Address of lowest byte written */
-	target_addr_t buf_addr_high; /* Address of highest byte written */
+	void *buf;                   /* Buffer for flash operations, buf_slots * writebufsize long */
+	size_t buf_slots;            /* Number of writebufsize slots in the buffer */
+	uint32_t buf_age;            /* Counter used to age the buffer slots */
+	target_flash_buf_s buf_slot[FLASH_BUFFER_SLOTS]; /* State of each buffer slot */
+	target_flash_range_s erased_range[FLASH_ERASED_RANGES]; /* Ranges erased in this flash session */
+	target_flash_range_s erase_pending[FLASH_ERASED_RANGES]; /* Ranges still to erase before they're written */
 	target_flash_s *next;        /* Next flash in list */
 };
 
@@ -100,10 +135,14 @@ struct target {
 	bool (*attach)(target_s *t);
 	void (*detach)(target_s *t);
 	bool (*check_error)(target_s *t);
+	/* Deferred error checking depth, and the faulting address check_error found if it can tell */
+	uint8_t error_check_deferred;
+	target_addr_t fault_addr;
 
 	/* Memory access functions */
 	void (*mem_read)(target_s *t, void *dest, target_addr_t src, size_t len);
 	void (*mem_write)(target_s *t, target_addr_t dest, const void *src, size_t len);
+	bool (*mem_poll32)(target_s *t, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout);
 
 	/* Register access functions */
 	size_t regs_size;
@@ -118,7 +157,13 @@ struct target {
 	void (*extended_reset)(target_s *t);
 	void (*halt_request)(target_s *t);
 	target_halt_reason_e (*halt_poll)(target_s *t, target_addr_t *watch);
+	bool (*halt_wait)(target_s *t, uint32_t timeout);
 	void (*halt_resume)(target_s *t, bool step);
+	/* Range being stepped through by target_halt_resume_range(), empty when not range stepping */
+	target_addr_t step_range_start;
+	target_addr_t step_range_end;
+	/* Set by target_halt_request() until the next resume, so the halt it causes is reported as such */
+	bool halt_requested;
 
 	/* Break-/watchpoint functions */
 	int (*breakwatch_set)(target_s *t, breakwatch_s *);
@@ -128,6 +173,9 @@ struct target {
 	/* Recovery functions */
 	bool (*mass_erase)(target_s *t);
 
+	/* Exercise the debug link, returning false if any access failed or read back wrong */
+	bool (*link_test)(target_s *t);
+
 	/* Flash functions */
 	bool (*enter_flash_mode)(target_s *t);
 	bool (*exit_flash_mode)(target_s *t);
@@ -181,6 +229,9 @@ void target_add_flash(target_s *t, target_flash_s *f);
 
 target_flash_s *target_flash_for_addr(target_s *t, uint32_t addr);
 
+/* Called by the SWD layer on signal integrity failures to step an automatically tuned clock down */
+void target_swj_frequency_backoff(void);
+
 /* Convenience function for MMIO access */
 uint32_t target_mem_read32(target_s *t, uint32_t addr);
 uint16_t target_mem_read16(target_s *t, uint32_t addr);
@@ -190,6 +241,22 @@ void target_mem_write16(target_s *t, uint32_t addr, uint16_t value);
 void target_mem_write8(target_s *t, uint32_t addr, uint8_t value);
 bool target_check_error(target_s *t);
 
+/*
+ * Stop target_mem_read()/target_mem_write() from checking the sticky error flags after every
+ * access. The flags accumulate until target_sync_error_check() (or an explicit target_check_error())
+ * which return true if any access in between failed. Calls nest, only the outermost sync checks.
+ */
+void target_defer_error_check(target_s *t);
+bool target_sync_error_check(target_s *t);
+
+/*
+ * Wait up to timeout ms for (*addr & mask) == value, polling on the probe where possible.
+ * Callers must still check target_check_error(), as a failed link can read back as a match.
+ * Long operations should poll in TARGET_POLL_SLICE chunks so progress can be reported.
+ */
+#define TARGET_POLL_SLICE 100U
+bool target_mem_poll32(target_s *t, uint32_t addr, uint32_t mask, uint32_t value, uint32_t timeout);
+
 /* Access to host controller interface */
 void tc_printf(target_s *t, const char *fmt, ...);
 